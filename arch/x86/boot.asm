@@ -2,7 +2,8 @@
 
 MBALIGN     equ  1<<0                   ; align loaded modules on page boundaries
 MEMINFO     equ  1<<1                   ; provide memory map
-MBFLAGS     equ  MBALIGN | MEMINFO      ; this is the Multiboot 'flag' field
+VIDEO       equ  1<<2                   ; ask for a linear framebuffer
+MBFLAGS     equ  MBALIGN | MEMINFO | VIDEO ; this is the Multiboot 'flag' field
 MAGIC       equ  0x1BADB002             ; 'magic number' lets bootloader find the header
 CHECKSUM    equ -(MAGIC + MBFLAGS)      ; checksum of above, to prove we are multiboot
 
@@ -12,6 +13,31 @@ align 4
     dd MAGIC
     dd MBFLAGS
     dd CHECKSUM
+    ; Load addresses, unused for an ELF kernel but present for the video fields
+    dd 0, 0, 0, 0, 0
+    ; Preferred video mode: linear framebuffer, 1280x800 (160x50 text), 32 bpp
+    dd 0
+    dd 1280
+    dd 800
+    dd 32
+
+; Segment selectors of the kernel's flat GDT, mirrored in interrupts.h
+KERNEL_CODE_SELECTOR equ 0x08
+KERNEL_DATA_SELECTOR equ 0x10
+
+; Flat 4 GiB ring 0 segments. Multiboot leaves GDTR undefined, so the
+; loader's table may already be gone; every interrupt reloads CS from here.
+section .data
+align 8
+gdt:
+    dq 0                        ; null descriptor
+    dq 0x00CF9A000000FFFF       ; code: base 0, limit 4 GiB, execute/read
+    dq 0x00CF92000000FFFF       ; data: base 0, limit 4 GiB, read/write
+gdt_end:
+
+gdt_pointer:
+    dw gdt_end - gdt - 1
+    dd gdt
 
 ; Stack space
 section .bss
@@ -24,9 +50,25 @@ stack_top:
 section .text
 global _start:function (_start.end - _start)
 _start:
+    ; Load our own GDT and reload every segment register from it. EAX and
+    ; EBX still hold the Multiboot magic and info pointer.
+    lgdt [gdt_pointer]
+    jmp KERNEL_CODE_SELECTOR:.reload_segments
+.reload_segments:
+    mov cx, KERNEL_DATA_SELECTOR
+    mov ds, cx
+    mov es, cx
+    mov fs, cx
+    mov gs, cx
+    mov ss, cx
+
     ; Set up the stack
     mov esp, stack_top
 
+    ; Pass the Multiboot magic (EAX) and info pointer (EBX) to the kernel
+    push ebx
+    push eax
+
     ; Call the kernel main function
     extern kernel_main
     call kernel_main
@@ -0,0 +1,102 @@
+; isr.asm - Interrupt entry stubs for CPU exceptions and PIC IRQs
+
+; Exceptions without a CPU-pushed error code get a dummy 0
+%macro ISR_NOERR 1
+isr%1:
+    push dword 0
+    push dword %1
+    jmp interrupt_common
+%endmacro
+
+%macro ISR_ERR 1
+isr%1:
+    push dword %1
+    jmp interrupt_common
+%endmacro
+
+%macro IRQ 1
+irq%1:
+    push dword 0
+    push dword (32 + %1)
+    jmp interrupt_common
+%endmacro
+
+section .text
+
+ISR_NOERR 0
+ISR_NOERR 1
+ISR_NOERR 2
+ISR_NOERR 3
+ISR_NOERR 4
+ISR_NOERR 5
+ISR_NOERR 6
+ISR_NOERR 7
+ISR_ERR   8
+ISR_NOERR 9
+ISR_ERR   10
+ISR_ERR   11
+ISR_ERR   12
+ISR_ERR   13
+ISR_ERR   14
+ISR_NOERR 15
+ISR_NOERR 16
+ISR_ERR   17
+ISR_NOERR 18
+ISR_NOERR 19
+ISR_NOERR 20
+ISR_ERR   21
+ISR_NOERR 22
+ISR_NOERR 23
+ISR_NOERR 24
+ISR_NOERR 25
+ISR_NOERR 26
+ISR_NOERR 27
+ISR_NOERR 28
+ISR_ERR   29
+ISR_ERR   30
+ISR_NOERR 31
+
+IRQ 0
+IRQ 1
+IRQ 2
+IRQ 3
+IRQ 4
+IRQ 5
+IRQ 6
+IRQ 7
+IRQ 8
+IRQ 9
+IRQ 10
+IRQ 11
+IRQ 12
+IRQ 13
+IRQ 14
+IRQ 15
+
+; Save registers, hand the frame to C, restore and return
+extern interrupt_dispatch
+interrupt_common:
+    pusha
+    cld
+    push esp                ; interrupt_frame_t*
+    call interrupt_dispatch
+    add esp, 4
+    popa
+    add esp, 8              ; vector and error code
+    iret
+
+; Stub addresses indexed by vector, used by interrupts.c to fill the IDT
+section .data
+align 4
+global interrupt_stub_table
+interrupt_stub_table:
+%assign i 0
+%rep 32
+    dd isr%+i
+%assign i i+1
+%endrep
+%assign i 0
+%rep 16
+    dd irq%+i
+%assign i i+1
+%endrep
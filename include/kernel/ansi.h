@@ -0,0 +1,41 @@
+#ifndef ANSI_H
+#define ANSI_H
+
+#include "types.h"
+
+// ANSI escape sequence parser: ESC '[' params final. The console feeds it
+// the characters of a sequence and acts on the finished command; SGR ('m')
+// sets colours, 'H' moves the cursor and '2J' clears, as on a terminal.
+
+#define ANSI_MAX_PARAMS 4    // Further parameters are parsed and dropped
+
+// VGA and ANSI number the eight base colours differently; the mapping is
+// its own inverse. Bright VGA colours (8-15) are ANSI 90-97 / 100-107.
+extern const uint8_t vga_ansi_color[8];
+
+enum { ANSI_NONE, ANSI_START, ANSI_CSI };
+
+typedef struct {
+    int state;                        // ANSI_NONE outside a sequence
+    uint32_t params[ANSI_MAX_PARAMS]; // Empty parameters are 0
+    size_t count;                     // Parameters given, at most ANSI_MAX_PARAMS
+    char final;                       // Command character once complete
+} ansi_parser_t;
+
+// What ansi_feed() did with a character
+enum {
+    ANSI_TEXT,      // Not part of a sequence
+    ANSI_PENDING,   // Consumed; the sequence continues or was abandoned
+    ANSI_COMMAND,   // Ended a CSI sequence: final and params hold it
+};
+
+void ansi_init(ansi_parser_t* parser);
+int ansi_feed(ansi_parser_t* parser, char c);
+
+// Text attribute after a completed SGR ('m') sequence
+uint8_t ansi_apply_sgr(const ansi_parser_t* parser, uint8_t attribute);
+
+// Zero-based position of a completed CUP ('H' or 'f') sequence
+void ansi_cursor_position(const ansi_parser_t* parser, size_t* row, size_t* col);
+
+#endif // ANSI_H
@@ -0,0 +1,16 @@
+#ifndef ATA_H
+#define ATA_H
+
+#include "types.h"
+
+#define ATA_MAX_DRIVES 4
+
+// Largest single transfer (one 64 KB PRD region)
+#define ATA_MAX_TRANSFER_SECTORS 128
+
+// Probe both legacy IDE channels and register every ATA disk found as a
+// block device (hda..hdd). Uses bus-master DMA when the PCI IDE controller
+// supports it and falls back to PIO otherwise. Returns the number of disks.
+int ata_init(void);
+
+#endif // ATA_H
@@ -0,0 +1,66 @@
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include "types.h"
+#include "blockdev.h"
+
+#define BCACHE_BLOCK_SIZE 4096
+#define BCACHE_SECTORS_PER_BLOCK (BCACHE_BLOCK_SIZE / BLOCKDEV_SECTOR_SIZE)
+#define BCACHE_NUM_BUFFERS 64
+#define BCACHE_HASH_SIZE 128
+#define BCACHE_READAHEAD_BLOCKS 8   // Blocks fetched per sequential miss
+#define BCACHE_FLUSH_BLOCKS 16      // Largest coalesced write-back request
+
+// Buffer flags
+#define BCACHE_VALID 0x01
+#define BCACHE_DIRTY 0x02
+
+// A cached device block
+typedef struct bcache_buffer {
+    block_device_t* dev;
+    uint32_t block;
+    uint8_t flags;
+    uint16_t refcount;
+    struct bcache_buffer* hash_next;
+    struct bcache_buffer* lru_prev;   // LRU list, most recent at the head
+    struct bcache_buffer* lru_next;
+    uint8_t data[BCACHE_BLOCK_SIZE];
+} bcache_buffer_t;
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t readahead_blocks;
+    uint32_t evictions;
+    uint32_t blocks_written;
+    uint32_t write_requests;     // Device requests issued by write-back
+} bcache_stats_t;
+
+// Initialize the buffer cache
+void bcache_init(void);
+
+// Get a pinned buffer holding a block, reading it if needed; NULL on error
+bcache_buffer_t* bcache_get(block_device_t* dev, uint32_t block);
+
+// Unpin a buffer returned by bcache_get
+void bcache_release(bcache_buffer_t* buf);
+
+// Mark a pinned buffer as modified; it is written back on flush or eviction
+void bcache_mark_dirty(bcache_buffer_t* buf);
+
+// Byte-granular access through the cache, starting offset bytes into
+// sector lba (so positions past 4 GB stay addressable); 0 on success
+int bcache_read(block_device_t* dev, uint32_t lba, uint32_t offset, void* buffer, size_t size);
+int bcache_write(block_device_t* dev, uint32_t lba, uint32_t offset, const void* buffer, size_t size);
+
+// Write back every dirty block of a device (all devices if NULL),
+// sorted and coalesced into as few device requests as possible
+int bcache_flush(block_device_t* dev);
+
+// Drop all clean, unpinned blocks of a device
+void bcache_invalidate(block_device_t* dev);
+
+// Get cache statistics
+void bcache_get_stats(bcache_stats_t* stats);
+
+#endif // BCACHE_H
@@ -0,0 +1,53 @@
+#ifndef BLOCKDEV_H
+#define BLOCKDEV_H
+
+#include "types.h"
+
+#define BLOCKDEV_SECTOR_SIZE 512
+#define BLOCKDEV_MAX_DEVICES 8
+#define BLOCKDEV_NAME_LENGTH 8
+
+// One transfer in a batch submitted with blockdev_submit()
+typedef struct {
+    uint32_t lba;
+    uint32_t count;
+    void* buffer;
+    bool write;
+    int status;                // Set on completion: 0 or a negative error
+} block_request_t;
+
+// A registered disk; drivers fill in the geometry and transfer functions
+typedef struct block_device {
+    char name[BLOCKDEV_NAME_LENGTH];
+    const char* driver;        // Short description shown by lsblk
+    uint32_t sector_count;
+    int (*read)(struct block_device* dev, uint32_t lba, uint32_t count, void* buffer);
+    int (*write)(struct block_device* dev, uint32_t lba, uint32_t count, const void* buffer);
+    // Optional: queue a whole batch at once and wait for every completion
+    int (*submit)(struct block_device* dev, block_request_t* requests, uint32_t count);
+    void* driver_data;
+    
+    // Statistics
+    uint32_t read_requests;
+    uint32_t write_requests;
+    uint32_t sectors_read;
+    uint32_t sectors_written;
+} block_device_t;
+
+// Register a device (the structure must stay valid); 0 on success
+int blockdev_register(block_device_t* dev);
+
+// Look up devices by name or registration order
+block_device_t* blockdev_get(const char* name);
+block_device_t* blockdev_get_index(int index);
+int blockdev_count(void);
+
+// Range-checked transfers in whole sectors; 0 on success
+int blockdev_read(block_device_t* dev, uint32_t lba, uint32_t count, void* buffer);
+int blockdev_write(block_device_t* dev, uint32_t lba, uint32_t count, const void* buffer);
+
+// Run a batch of requests, letting the driver overlap them when it can.
+// Returns 0 if every request succeeded; per-request results are in status.
+int blockdev_submit(block_device_t* dev, block_request_t* requests, uint32_t count);
+
+#endif // BLOCKDEV_H
@@ -27,9 +27,45 @@ enum vga_color {
 #define VGA_COLOR_YELLOW VGA_COLOR_BROWN
 #define VGA_COLOR_LIGHT_YELLOW VGA_COLOR_LIGHT_BROWN
 
+// ANSI colour sequences the console understands inside written text, so a
+// coloured line can be one printf. CONSOLE_RESET is light grey on black.
+#define CONSOLE_RESET         "\033[0m"
+#define CONSOLE_LIGHT_RED     "\033[91m"
+#define CONSOLE_LIGHT_GREEN   "\033[92m"
+#define CONSOLE_YELLOW        "\033[93m"
+#define CONSOLE_LIGHT_BLUE    "\033[94m"
+#define CONSOLE_LIGHT_MAGENTA "\033[95m"
+#define CONSOLE_LIGHT_CYAN    "\033[96m"
+#define CONSOLE_WHITE         "\033[97m"
+
+// Console outputs for console_set_outputs()
+#define CONSOLE_OUTPUT_VGA    0x01  // The screen, in text mode or on a framebuffer
+#define CONSOLE_OUTPUT_SERIAL 0x02
+
+// A linear framebuffer set up by the boot loader
+typedef struct {
+    uint32_t address;
+    uint32_t pitch;             // Bytes per scan line
+    uint32_t width;             // Pixels
+    uint32_t height;
+    uint8_t bpp;
+    uint8_t red_position, red_size;
+    uint8_t green_position, green_size;
+    uint8_t blue_position, blue_size;
+} console_framebuffer_t;
+
+// Draw text into a framebuffer instead of VGA text memory, with as many
+// 8x16 cells as fit (up to 160x64). Call before console_init(). Returns -1
+// unless the format has 15, 16, 24 or 32 bits per pixel and fits 80x25.
+int console_use_framebuffer(const console_framebuffer_t* fb);
+
 // Initialize the console
 void console_init(void);
 
+// Choose where output goes: the screen (the default), the serial port once
+// serial_init() has found one, or both
+void console_set_outputs(unsigned outputs);
+
 // Clear the console
 void console_clear(void);
 
@@ -45,6 +81,15 @@ void console_write(const char* data);
 // Write a string with a specified length to the console
 void console_write_size(const char* data, size_t size);
 
+// Copy pending output to the screen (the functions above do this before
+// they return)
+void console_flush(void);
+
+// Look back through lines that scrolled off the top: positive moves the
+// view up by that many lines, negative back down. New output returns to
+// the live screen.
+void console_scroll_view(int lines);
+
 // Get current cursor position
 void console_get_cursor(size_t* row, size_t* col);
 
@@ -0,0 +1,74 @@
+#ifndef FAT32_H
+#define FAT32_H
+
+#include "types.h"
+#include "blockdev.h"
+
+#define FAT32_MAX_VOLUMES 2
+#define FAT32_MAX_NAME 128
+#define FAT32_RUN_CACHE_FILES 8      // Files whose cluster runs are kept
+#define FAT32_MAX_RUNS 32            // Runs remembered per file
+#define FAT32_MAX_TRANSFER 128       // Sectors per device request for file data
+
+// Directory entry attributes
+#define FAT32_ATTR_READ_ONLY 0x01
+#define FAT32_ATTR_HIDDEN    0x02
+#define FAT32_ATTR_SYSTEM    0x04
+#define FAT32_ATTR_VOLUME_ID 0x08
+#define FAT32_ATTR_DIRECTORY 0x10
+#define FAT32_ATTR_LFN       0x0F
+
+// A decoded directory entry (long name when present, else the 8.3 name)
+typedef struct {
+    char name[FAT32_MAX_NAME];
+    uint8_t attr;
+    uint32_t first_cluster;
+    uint32_t size;
+} fat32_dirent_t;
+
+// A stretch of consecutive clusters
+typedef struct {
+    uint32_t cluster;
+    uint32_t count;
+} fat32_run_t;
+
+// Cluster chain of one file, split into contiguous runs
+typedef struct {
+    uint32_t first_cluster;    // 0 = slot unused
+    uint32_t num_runs;
+    bool complete;             // False if the chain has more runs than fit
+    uint32_t last_used;
+    fat32_run_t runs[FAT32_MAX_RUNS];
+} fat32_chain_t;
+
+typedef struct {
+    block_device_t* dev;
+    uint32_t part_start;           // First sector of the volume on the device
+    uint32_t sectors_per_cluster;
+    uint32_t fat_start;            // Device sectors
+    uint32_t data_start;
+    uint32_t cluster_count;
+    uint32_t root_cluster;
+    char label[12];
+
+    // Recently used cluster chains, so rereads skip the FAT walk
+    fat32_chain_t chains[FAT32_RUN_CACHE_FILES];
+    uint32_t chain_clock;
+
+    // Statistics
+    uint32_t chain_hits;
+    uint32_t chain_misses;
+    uint32_t data_requests;
+} fat32_volume_t;
+
+// Mount the FAT32 volume on a device (whole disk or first FAT32 partition)
+fat32_volume_t* fat32_mount(block_device_t* dev);
+
+// Path operations; paths are relative to the volume root ("/" is the root)
+int fat32_stat(fat32_volume_t* vol, const char* path, fat32_dirent_t* entry);
+int fat32_list_directory(fat32_volume_t* vol, const char* path, char* buffer, size_t buffer_size);
+
+// Read up to size bytes at offset; returns the byte count or < 0 on error
+int fat32_read(fat32_volume_t* vol, const char* path, uint32_t offset, void* buffer, size_t size);
+
+#endif // FAT32_H
@@ -0,0 +1,23 @@
+#ifndef FONT_H
+#define FONT_H
+
+#include "types.h"
+
+// Bitmap console font: FONT_HEIGHT rows per glyph, one byte per row with the
+// leftmost pixel in the top bit
+#define FONT_WIDTH  8
+#define FONT_HEIGHT 16
+#define FONT_FIRST_CHAR 0x20
+#define FONT_GLYPHS 96          // ' ' to DEL, which is drawn as a box
+
+extern const uint8_t font_8x16[FONT_GLYPHS][FONT_HEIGHT];
+
+// Glyph for a character; anything without one shows as the box
+static inline const uint8_t* font_glyph(unsigned char c) {
+    if (c < FONT_FIRST_CHAR || c >= FONT_FIRST_CHAR + FONT_GLYPHS) {
+        c = FONT_FIRST_CHAR + FONT_GLYPHS - 1;
+    }
+    return font_8x16[c - FONT_FIRST_CHAR];
+}
+
+#endif // FONT_H
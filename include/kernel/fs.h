@@ -9,11 +9,30 @@
 #define FS_TOTAL_DATA_SIZE (FS_MAX_FILES * FS_MAX_FILE_SIZE)
 #define FS_MAX_PATH_DEPTH 32
 
+// File data lives in fixed-size blocks that files with identical contents
+// share; a block is copied before one of its sharers modifies it
+#define FS_BLOCK_SIZE 512
+#define FS_NUM_BLOCKS (FS_TOTAL_DATA_SIZE / FS_BLOCK_SIZE)
+#define FS_MAX_FILE_BLOCKS (FS_MAX_FILE_SIZE / FS_BLOCK_SIZE)
+#define FS_HASH_BUCKETS 4096
+#define FS_NO_BLOCK 0xFFFF
+
+#define FS_MAX_SNAPSHOTS 4
+
+// Compressed files are split into blocks that decompress independently
+#define FS_COMPRESS_BLOCK 4096
+
+// fs_entry_t flags
+#define FS_FLAG_COMPRESS   0x01  // Compress contents; on a directory, new files inherit it
+#define FS_FLAG_COMPRESSED 0x02  // Contents are stored compressed
+
 typedef struct {
     char filename[FS_MAX_FILENAME_LENGTH];
     uint32_t size;
-    uint32_t data_offset;
+    uint16_t blocks[FS_MAX_FILE_BLOCKS]; // Data blocks holding the stored bytes, in order
     uint8_t is_directory;
+    uint8_t flags;         // FS_FLAG_*
+    uint16_t stored_size;  // Bytes in the data area when compressed
     uint32_t created_time;
     uint32_t modified_time;
     uint32_t permissions;  // rwx permissions
@@ -24,17 +43,52 @@ typedef struct {
     fs_entry_t entries[FS_MAX_FILES];
     uint32_t num_entries;
     uint8_t data[FS_TOTAL_DATA_SIZE];
-    uint32_t data_used;
+    uint32_t data_used;    // Bytes in blocks that are in use
     char current_path[FS_MAX_FILENAME_LENGTH];
+    
+    // Derived from the entries: saved with images, rebuilt when an
+    // instance is mounted. Block sharing: how many file blocks map to each data
+    // block, and a content hash index over the blocks in use.
+    uint16_t block_refs[FS_NUM_BLOCKS];
+    uint32_t block_hash[FS_NUM_BLOCKS];  // 0 while not indexed
+    uint16_t hash_next[FS_NUM_BLOCKS];
+    uint16_t hash_buckets[FS_HASH_BUCKETS];
+    uint32_t next_block;                 // Where the allocator looks first
+    uint16_t sorted[FS_MAX_FILES];       // Entry indices in path order
 } filesystem_t;
 
-// Initialize the file system
+// Operation counters, shared by every instance
+typedef struct {
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t creates;
+    uint32_t deletes;
+    uint32_t bytes_read;
+    uint32_t bytes_written;
+} fs_counters_t;
+
+// Prebuilt filesystem images: a header followed by a raw filesystem_t
+#define FS_IMAGE_MAGIC 0x49534641  // "AFSI"
+#define FS_IMAGE_VERSION 3
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t header_size;  // Offset of the filesystem_t within the image
+    uint32_t image_size;   // sizeof(filesystem_t) the image was built with
+} fs_image_header_t;
+
+// Initialize the file system with the default directory tree
 void fs_init(void);
 
+// Empty the current instance, leaving only the root directory
+void fs_format(void);
+
 // File operations
 int fs_create_file(const char* filename, uint8_t is_directory);
 int fs_write_file(const char* filename, const void* data, size_t size);
 int fs_read_file(const char* filename, void* buffer, size_t buffer_size);
+int fs_read_at(const char* filename, uint32_t offset, void* buffer, size_t buffer_size);
 int fs_delete_file(const char* filename);
 int fs_file_exists(const char* filename);
 size_t fs_file_size(const char* filename);
@@ -53,10 +107,83 @@ void fs_get_directory(const char* path, char* directory, size_t size);
 
 // Utility functions
 void fs_get_stats(uint32_t* total_files, uint32_t* total_size, uint32_t* free_size);
+void fs_get_counters(fs_counters_t* counters);
+
+// Bytes the live files' blocks add up to, and the bytes those blocks take
+// with shared ones counted once. Blocks only snapshots map are left out.
+void fs_get_dedup_stats(uint32_t* logical_size, uint32_t* physical_size);
 const char* fs_get_file_type_string(const char* filename);
 void fs_get_permissions_string(const char* filename, char* perms, size_t size);
 
 // Get the global filesystem instance
 filesystem_t* fs_get_instance(void);
 
+// Make another instance current for the following calls; returns the old one
+filesystem_t* fs_use(filesystem_t* instance);
+
+// Find an entry by path (directories match with or without a trailing '/')
+const fs_entry_t* fs_lookup(const char* path);
+
+// Path-ordered access. Entries whose path starts with prefix form one run
+// of positions; returns its length and sets *first, in O(log n).
+uint32_t fs_prefix_range(const char* prefix, uint32_t* first);
+const fs_entry_t* fs_entry_at(uint32_t position);
+
+// Called by fs_walk for each entry beneath the root, parents before their
+// children. depth is 0 for the root's own entries; total is a file's size,
+// or for a directory the size of everything beneath it. Nonzero stops.
+typedef int (*fs_walk_fn)(const fs_entry_t* entry, uint32_t depth, uint32_t total, void* context);
+
+// Visit everything beneath a directory in one pass over its run of the
+// path index. The visitor must not change the file system. Returns the
+// number of entries visited, or -1 if root is not a directory.
+int fs_walk(const char* root, fs_walk_fn visit, void* context);
+
+// Bytes an entry occupies in the data area
+uint32_t fs_entry_stored_size(const fs_entry_t* entry);
+
+// Turn compression of a file (rewritten in place) or directory on or off
+int fs_set_compression(const char* filename, bool enable);
+
+// Snapshots of the current instance. Creating one copies only the entry
+// table and shares every data block, so blocks are copied lazily as the
+// live files change. Snapshots are kept in memory only and are dropped
+// when the instance is loaded from an image or a disk.
+int fs_snapshot_create(void);                 // Snapshot id, or -1 if all slots are in use
+int fs_snapshot_restore(int id);              // Put every file back as it was; 0 on success
+int fs_snapshot_delete(int id);
+int fs_snapshot_info(int id, uint32_t* num_entries, uint32_t* created_time);
+
+// Move up to max_moves blocks so each file's data is one run and the files
+// are packed at the start of the data area. Returns the blocks moved (0 once
+// nothing is left to do) or < 0 on an I/O error; meant to be called
+// repeatedly, e.g. while idle.
+int fs_compact_step(uint32_t max_moves);
+
+// Files holding data and the contiguous runs of blocks they occupy
+void fs_get_fragmentation(uint32_t* files, uint32_t* extents);
+
+// Adopt a prebuilt image as the global instance (no copy); 0 on success
+int fs_load_image(void* image, size_t size);
+
+// Fill in the header for an image of the current filesystem_t layout
+void fs_init_image_header(fs_image_header_t* header);
+
+// Flush the filesystem to its backing store, if it has one
+int fs_sync(void);
+
+// Replay the log opened with journal_open(), skipping transactions older
+// than checkpoint_sequence, then log every later update through it.
+// Returns the number of transactions replayed or < 0 on error.
+int fs_journal_start(uint32_t checkpoint_sequence);
+
+// Commit the updates logged since the last commit as one transaction
+int fs_commit(void);
+
+#ifdef TEST_MODE
+// Map a host file as the backing store (created and formatted if empty).
+// Returns 1 for a newly formatted file, 0 for an existing one, < 0 on error.
+int fs_open_backing_file(const char* path);
+#endif
+
 #endif // FS_H
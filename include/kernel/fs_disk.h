@@ -0,0 +1,66 @@
+#ifndef FS_DISK_H
+#define FS_DISK_H
+
+#include "types.h"
+#include "blockdev.h"
+#include "fs.h"
+
+// On-disk layout of the Alpha file system, in sectors. Every region starts
+// on a buffer cache block so cached blocks never straddle two regions:
+//
+//   superblock | journal | entry table | allocation bitmap | data
+//
+// The entry table holds raw fs_entry_t records and the data region mirrors
+// filesystem_t.data byte for byte. Mount reads the superblock, the used
+// part of the table and the bitmap; file data is faulted in per sector on
+// first access.
+
+#define FS_DISK_MAGIC 0x44534641    // "AFSD"
+#define FS_DISK_VERSION 2
+#define FS_DISK_JOURNAL_SECTORS 512
+#define FS_DISK_DATA_SECTORS (FS_TOTAL_DATA_SIZE / BLOCKDEV_SECTOR_SIZE)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_size;           // sizeof(fs_entry_t) at format time
+    uint32_t max_entries;
+    uint32_t journal_start;
+    uint32_t journal_sectors;
+    uint32_t table_start;
+    uint32_t table_sectors;
+    uint32_t bitmap_start;         // One bit per data sector holding file data
+    uint32_t bitmap_sectors;
+    uint32_t data_start;
+    uint32_t data_sectors;
+    uint32_t num_entries;          // Table state as of the last checkpoint
+    uint32_t data_used;
+    uint32_t checkpoint_sequence;  // First journal transaction not yet checkpointed
+} fs_superblock_t;
+
+// Write the current file system to a device and keep it attached.
+// 0 on success, -1 if the device is too small, < -1 on I/O errors.
+int fs_disk_format(block_device_t* dev);
+
+// Attach to a formatted device and replay its journal. Returns the number
+// of journal transactions replayed, -2 if the device holds no file system,
+// other negative values on errors.
+int fs_disk_mount(block_device_t* dev);
+
+// Checkpoint the journal: write changed state to its home location
+int fs_disk_sync(void);
+
+// Data access hooks used by fs.c; no-ops when no disk is attached.
+// fault_in makes bytes resident before they are read; write_prepare is
+// called before bytes are overwritten and marks them dirty.
+int fs_disk_fault_in(uint32_t offset, uint32_t size);
+int fs_disk_write_prepare(uint32_t offset, uint32_t size);
+
+// True if the bytes are already in memory (always, with no disk attached)
+bool fs_disk_is_resident(uint32_t offset, uint32_t size);
+
+// Attached device (NULL if none) and how much of its data is resident
+block_device_t* fs_disk_get_device(void);
+uint32_t fs_disk_resident_sectors(void);
+
+#endif // FS_DISK_H
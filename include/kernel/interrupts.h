@@ -0,0 +1,44 @@
+#ifndef INTERRUPTS_H
+#define INTERRUPTS_H
+
+#include "types.h"
+
+// Flat segments of the GDT loaded by arch/x86/boot.asm
+#define KERNEL_CODE_SELECTOR 0x08
+#define KERNEL_DATA_SELECTOR 0x10
+
+#define IRQ_BASE_VECTOR 32
+#define IRQ_COUNT 16
+
+// Hardware IRQ lines
+#define IRQ_TIMER    0
+#define IRQ_KEYBOARD 1
+#define IRQ_CASCADE  2
+#define IRQ_COM1     4
+#define IRQ_ATA_PRIMARY   14
+#define IRQ_ATA_SECONDARY 15
+
+// Register state pushed by the entry stubs in arch/x86/isr.asm
+typedef struct {
+    uint32_t edi, esi, ebp, esp, ebx, edx, ecx, eax;
+    uint32_t vector;
+    uint32_t error_code;
+    uint32_t eip, cs, eflags;
+} interrupt_frame_t;
+
+// IRQ handler function type
+typedef void (*irq_handler_t)(interrupt_frame_t* frame);
+
+// Set up the IDT and remap the PIC (interrupts stay disabled)
+void interrupts_init(void);
+
+// Install a handler and unmask the IRQ line
+void irq_register_handler(uint8_t irq, irq_handler_t handler);
+
+// Number of times an IRQ line has fired since boot
+uint32_t irq_get_count(uint8_t irq);
+
+// Called from the assembly stubs for every vector
+void interrupt_dispatch(interrupt_frame_t* frame);
+
+#endif // INTERRUPTS_H
@@ -0,0 +1,80 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "types.h"
+#include "blockdev.h"
+
+// Write-ahead log kept in a fixed region of a block device. Sector 0 of
+// the region holds journal_header_t; committed transactions follow it
+// back to back, each a journal_tx_header_t and its records padded to a
+// whole sector. A checkpoint writes the live state to its home location
+// and empties the log.
+
+#define JOURNAL_MAGIC 0x4A534641     // "AFSJ"
+#define JOURNAL_TX_MAGIC 0x58544A41  // "AJTX"
+#define JOURNAL_TX_SIZE 32768        // Largest transaction, header included
+
+typedef struct {
+    uint32_t magic;
+    uint32_t sequence;     // Sequence number of the first transaction in the log
+} journal_header_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t sequence;
+    uint32_t num_records;
+    uint32_t length;       // Record bytes following this header
+    uint32_t checksum;     // CRC32 of the record bytes; a torn write fails it
+} journal_tx_header_t;
+
+// Record header; length bytes of payload follow, padded to 4 bytes
+typedef struct {
+    uint16_t type;
+    uint16_t reserved;
+    uint32_t length;
+} journal_record_t;
+
+typedef struct {
+    uint32_t transactions;
+    uint32_t records;
+    uint32_t sectors_written;
+    uint32_t checkpoints;
+} journal_stats_t;
+
+// Called for every record of a committed transaction during replay
+typedef int (*journal_apply_t)(uint16_t type, const void* payload, uint32_t length);
+
+// Writes the live state to its home location when the log fills up.
+// next_sequence is the first sequence the emptied log will use; the home
+// state must remember it so replay can skip transactions it already holds.
+typedef int (*journal_checkpoint_t)(uint32_t next_sequence);
+
+// Write an empty log to a region of a device
+int journal_format(block_device_t* dev, uint32_t start_lba, uint32_t num_sectors);
+
+// Attach to an existing log; 0 on success, -2 if the region holds no log
+int journal_open(block_device_t* dev, uint32_t start_lba, uint32_t num_sectors,
+                 journal_checkpoint_t checkpoint);
+
+// Apply committed transactions, skipping those older than checkpoint_sequence.
+// Returns the number of transactions replayed, -1 on a read error or -2 if
+// apply rejected a record.
+int journal_replay(journal_apply_t apply, uint32_t checkpoint_sequence);
+
+// Add a record to the open transaction and return its payload area for the
+// caller to fill in. NULL once the transaction is full: the rest of it is
+// not logged, and the next commit checkpoints instead.
+void* journal_reserve(uint16_t type, uint32_t length);
+
+// Write the open transaction to the log as one device request, or
+// checkpoint if it overflowed or the log is full. Call only between
+// operations, where the live state is consistent.
+int journal_commit(void);
+
+// Force a checkpoint, leaving an empty log
+int journal_checkpoint(void);
+
+bool journal_is_open(void);
+void journal_get_stats(journal_stats_t* stats);
+
+#endif // JOURNAL_H
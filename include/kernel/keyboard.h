@@ -30,4 +30,8 @@ void keyboard_clear_buffer(void);
 // Poll the keyboard (call this regularly)
 void keyboard_poll(void);
 
+// Run a function over and over while keyboard_get_line() waits for a key.
+// It should do a small bounded amount of work each call; NULL stops it.
+void keyboard_set_idle_handler(void (*handler)(void));
+
 #endif // KEYBOARD_H
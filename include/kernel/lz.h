@@ -0,0 +1,20 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include "types.h"
+
+// Byte-oriented LZ77 codec in the style of LZ4: a token byte holding the
+// literal and match lengths, the literals, then a 16-bit match offset.
+// Single-probe hashing keeps compression fast; decoding is copies only.
+
+#define LZ_MAX_INPUT 65535   // Offsets and hash positions are 16-bit
+
+// Compress size bytes into at most capacity bytes.
+// Returns the compressed size, or -1 if it does not fit.
+int lz_compress(const uint8_t* src, uint32_t size, uint8_t* dst, uint32_t capacity);
+
+// Decompress into at most capacity bytes.
+// Returns the decompressed size, or -1 if the input is malformed.
+int lz_decompress(const uint8_t* src, uint32_t size, uint8_t* dst, uint32_t capacity);
+
+#endif // LZ_H
@@ -29,8 +29,17 @@ void* realloc(void* ptr, size_t size);
 // Allocate and zero memory
 void* calloc(size_t nmemb, size_t size);
 
+// Allocator activity since boot (all zero in TEST_MODE, where the host
+// malloc is used)
+typedef struct {
+    uint32_t allocations;
+    uint32_t frees;
+    uint32_t failed;       // Allocations that found no free block
+} memory_counters_t;
+
 // Get memory statistics
 void memory_get_stats(size_t* total, size_t* used, size_t* free);
+void memory_get_counters(memory_counters_t* counters);
 
 // Check heap integrity
 bool memory_check_integrity(void);
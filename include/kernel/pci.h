@@ -0,0 +1,69 @@
+#ifndef PCI_H
+#define PCI_H
+
+#include "types.h"
+
+// Configuration space registers
+#define PCI_VENDOR_ID     0x00
+#define PCI_DEVICE_ID     0x02
+#define PCI_COMMAND       0x04
+#define PCI_CLASS_REVISION 0x08
+#define PCI_HEADER_TYPE   0x0E
+#define PCI_BAR0          0x10
+#define PCI_BAR4          0x20
+#define PCI_INTERRUPT_LINE 0x3C
+
+// PCI_COMMAND bits
+#define PCI_COMMAND_IO         (1 << 0)
+#define PCI_COMMAND_MEMORY     (1 << 1)
+#define PCI_COMMAND_BUS_MASTER (1 << 2)
+
+// Device classes
+#define PCI_CLASS_STORAGE 0x01
+#define PCI_SUBCLASS_IDE  0x01
+
+#define PCI_MAX_DEVICES 32
+
+// Location of a function on the bus
+typedef struct {
+    uint8_t bus;
+    uint8_t device;
+    uint8_t function;
+} pci_address_t;
+
+// A function found during enumeration
+typedef struct {
+    pci_address_t addr;
+    uint16_t vendor_id;
+    uint16_t device_id;
+    uint8_t class_code;
+    uint8_t subclass;
+    uint8_t prog_if;
+    uint8_t irq_line;
+} pci_device_t;
+
+// Scan every bus once and record the functions found; returns the count
+int pci_init(void);
+
+// Enumerated devices in bus order
+int pci_device_count(void);
+const pci_device_t* pci_get_device(int index);
+
+// Configuration space access
+uint32_t pci_config_read32(pci_address_t addr, uint8_t offset);
+uint16_t pci_config_read16(pci_address_t addr, uint8_t offset);
+uint8_t pci_config_read8(pci_address_t addr, uint8_t offset);
+void pci_config_write32(pci_address_t addr, uint8_t offset, uint32_t value);
+void pci_config_write16(pci_address_t addr, uint8_t offset, uint16_t value);
+
+// Find the first enumerated function by class or by vendor/device ID
+const pci_device_t* pci_find_class(uint8_t class_code, uint8_t subclass);
+const pci_device_t* pci_find_device(uint16_t vendor_id, uint16_t device_id);
+
+// Human readable class name for lspci
+const char* pci_class_name(uint8_t class_code);
+
+// Enable I/O decoding and bus mastering (DMA) for a function
+void pci_enable_bus_master(pci_address_t addr);
+
+#endif // PCI_H
@@ -0,0 +1,37 @@
+#ifndef SCROLLBACK_H
+#define SCROLLBACK_H
+
+#include "types.h"
+
+// Lines that scroll off the top of the console are kept in a byte ring as
+// variable-size records, oldest evicted first:
+//
+//   size | length | (count, attribute) runs covering length | characters | size
+//
+// Trailing blanks are dropped and each colour change costs two bytes, so a
+// typical line takes a third of the bytes of its cells. size is 16 bits,
+// low byte first, and sits at both ends so the ring can be walked from
+// either side. Override the budget with -D.
+#ifndef CONSOLE_SCROLLBACK_SIZE
+#define CONSOLE_SCROLLBACK_SIZE 16384
+#endif
+#define SCROLLBACK_MAX_WIDTH 160
+#define SCROLLBACK_BLANK 0x0720    // ' ' in light grey on black
+
+typedef struct {
+    uint8_t ring[CONSOLE_SCROLLBACK_SIZE];
+    uint32_t head;    // Where the next record goes
+    uint32_t used;    // Bytes held, ending at the head
+    uint32_t lines;
+} scrollback_t;
+
+void scrollback_init(scrollback_t* sb);
+
+// Save a row of width text cells (at most SCROLLBACK_MAX_WIDTH)
+void scrollback_append(scrollback_t* sb, const uint16_t* row, size_t width);
+
+// Decode the saved line back lines from the newest (0, below sb->lines)
+// into a row of width cells, padded with blanks
+void scrollback_decode(const scrollback_t* sb, uint32_t back, uint16_t* row, size_t width);
+
+#endif // SCROLLBACK_H
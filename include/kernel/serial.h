@@ -0,0 +1,27 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include "types.h"
+
+// Ring sizes (powers of two)
+#define SERIAL_TX_BUFFER_SIZE 4096
+#define SERIAL_RX_BUFFER_SIZE 256
+
+// Probe and program COM1 for 115200 8N1 with FIFOs and take IRQ4.
+// Returns 0 when a UART answered, -1 otherwise.
+int serial_init(void);
+
+// True once serial_init() found a UART
+bool serial_present(void);
+
+// Queue bytes for transmission. The IRQ handler feeds them to the FIFO;
+// when the ring is full this waits for room by draining it directly.
+void serial_write(const char* data, size_t size);
+
+// Transmit everything queued before returning (works with interrupts off)
+void serial_flush(void);
+
+// Next received byte, or -1 when none is waiting
+int serial_read(void);
+
+#endif // SERIAL_H
@@ -18,6 +18,8 @@ typedef struct {
     command_handler_t handler;
     char* help;
     char* usage;
+    uint32_t calls;        // Times run since boot
+    uint32_t ticks;        // Timer ticks spent running it
 } shell_command_t;
 
 // Initialize the shell
@@ -41,6 +43,11 @@ const char* shell_get_current_dir(void);
 // Set current directory
 void shell_set_current_dir(const char* dir);
 
+// Registered commands with their usage counters
+int shell_get_command_count(void);
+const shell_command_t* shell_get_command(int index);
+uint32_t shell_get_unknown_count(void);
+
 // Command history functions
 void shell_add_to_history(const char* command);
 const char* shell_get_history(int index);
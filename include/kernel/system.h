@@ -25,6 +25,40 @@ static inline uint8_t inb(uint16_t port) {
     return ret;
 }
 
+static inline void outw(uint16_t port, uint16_t val) {
+    __asm__ volatile ("outw %0, %1" : : "a"(val), "Nd"(port));
+}
+
+static inline uint16_t inw(uint16_t port) {
+    uint16_t ret;
+    __asm__ volatile ("inw %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static inline void outl(uint16_t port, uint32_t val) {
+    __asm__ volatile ("outl %0, %1" : : "a"(val), "Nd"(port));
+}
+
+static inline uint32_t inl(uint16_t port) {
+    uint32_t ret;
+    __asm__ volatile ("inl %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+// Block transfers of 16-bit words (ATA PIO data port)
+static inline void insw(uint16_t port, void* buffer, uint32_t count) {
+    __asm__ volatile ("rep insw" : "+D"(buffer), "+c"(count) : "d"(port) : "memory");
+}
+
+static inline void outsw(uint16_t port, const void* buffer, uint32_t count) {
+    __asm__ volatile ("rep outsw" : "+S"(buffer), "+c"(count) : "d"(port));
+}
+
+// Order memory accesses against a device that shares memory with us
+static inline void memory_barrier(void) {
+    __asm__ volatile ("lock; addl $0, 0(%%esp)" : : : "memory", "cc");
+}
+
 // Wait a small amount of time
 static inline void io_wait(void) {
     outb(0x80, 0);
@@ -40,15 +74,38 @@ static inline void sti(void) {
     __asm__ volatile ("sti");
 }
 
+// Disable interrupts, returning whether they were enabled, for code that may
+// also run from a handler or after a panic
+static inline bool irq_save(void) {
+    uint32_t flags;
+    __asm__ volatile ("pushfl; popl %0; cli" : "=r"(flags) : : "memory");
+    return (flags & 0x200) != 0;
+}
+
+static inline void irq_restore(bool enabled) {
+    if (enabled) {
+        sti();
+    }
+}
+
 // Halt the CPU
 static inline void hlt(void) {
     __asm__ volatile ("hlt");
 }
 
+// Sleep until the next interrupt; call with interrupts disabled so a wakeup
+// between checking a condition and halting cannot be lost
+static inline void cpu_idle(void) {
+    __asm__ volatile ("sti; hlt; cli");
+}
+
 #define system_exit(code) do { while(1) hlt(); } while(0)
 #define system_halt() do { while(1) hlt(); } while(0)
 #endif
 
+// Timer interrupt frequency (ticks per second)
+#define SYSTEM_TIMER_HZ 100
+
 // System initialization
 void system_init(void);
 
@@ -0,0 +1,99 @@
+#ifndef VFS_H
+#define VFS_H
+
+#include "types.h"
+#include "fs.h"
+
+#define VFS_MAX_MOUNTS 8
+#define VFS_SOURCE_LENGTH 16
+
+// Error codes returned by every vfs_* call and backend operation
+#define VFS_ENOENT  -1   // No such file or directory
+#define VFS_EROFS   -2   // Read-only file system
+#define VFS_EIO     -3   // I/O error
+#define VFS_EISDIR  -4   // Is a directory
+#define VFS_ENOSPC  -5   // No space left
+#define VFS_EEXIST  -6   // File exists
+#define VFS_EBUSY   -7   // Mount point or root in use
+#define VFS_ENOTSUP -8   // Not supported by this file system
+
+typedef struct {
+    uint32_t size;
+    uint32_t stored_size;      // Space used in the backend (less if compressed)
+    bool is_directory;
+    uint32_t permissions;      // rwx bits as in fs_entry_t
+    uint32_t modified_time;
+} vfs_stat_t;
+
+struct vfs_mount;
+
+// Called by vfs_walk for each entry beneath the walked directory, parents
+// before their children, with its absolute path. depth is 0 for the
+// directory's own entries; total is a file's size, or for a directory the
+// size of everything beneath it. Nonzero stops the walk.
+typedef int (*vfs_walk_fn)(const char* path, const vfs_stat_t* st, uint32_t depth, uint32_t total, void* context);
+
+// Backend operations. Paths are relative to the mount and start with '/'
+// ("/" is the mount root); a NULL operation fails with VFS_EROFS.
+typedef struct {
+    const char* name;
+    int (*stat)(struct vfs_mount* mnt, const char* path, vfs_stat_t* st);
+    // Returns the byte count, 0 at end of file
+    int (*read)(struct vfs_mount* mnt, const char* path, uint32_t offset, void* buffer, size_t size);
+    // Replaces the whole contents, creating the file if needed
+    int (*write)(struct vfs_mount* mnt, const char* path, const void* data, size_t size);
+    int (*create)(struct vfs_mount* mnt, const char* path, bool is_directory);
+    int (*remove)(struct vfs_mount* mnt, const char* path);
+    // Same format as fs_list_directory: one name per line, directories end in '/'
+    int (*list)(struct vfs_mount* mnt, const char* path, char* buffer, size_t size);
+    int (*sync)(struct vfs_mount* mnt);
+    // Optional: turn transparent compression on or off for a file, or for
+    // the files later created in a directory
+    int (*compress)(struct vfs_mount* mnt, const char* path, bool enable);
+    // Optional: visit everything beneath a directory; returns the count
+    int (*walk)(struct vfs_mount* mnt, const char* path, vfs_walk_fn visit, void* context);
+} vfs_ops_t;
+
+typedef struct vfs_mount {
+    char path[FS_MAX_FILENAME_LENGTH];
+    size_t prefix_len;         // Characters of path covered (0 for "/")
+    char source[VFS_SOURCE_LENGTH];
+    const vfs_ops_t* ops;
+    void* data;                // Backend instance
+} vfs_mount_t;
+
+// Backends
+extern const vfs_ops_t ramfs_ops;   // data: filesystem_t*, NULL for the global instance
+extern const vfs_ops_t devfs_ops;
+extern const vfs_ops_t procfs_ops;
+extern const vfs_ops_t fat32_vfs_ops; // data: fat32_volume_t*
+
+// Mount the global file system at "/" and the RAM, device and process
+// file systems at /tmp, /dev and /proc
+void vfs_init(void);
+
+// Attach a backend at an absolute path; the mount point is created in
+// the covering file system if it can be. 0 on success.
+int vfs_mount(const char* path, const char* source, const vfs_ops_t* ops, void* data);
+
+// Operations on absolute, normalized paths
+int vfs_stat(const char* path, vfs_stat_t* st);
+int vfs_read(const char* path, uint32_t offset, void* buffer, size_t size);
+int vfs_write(const char* path, const void* data, size_t size);
+int vfs_create(const char* path, bool is_directory);
+int vfs_remove(const char* path);
+int vfs_list(const char* path, char* buffer, size_t size);
+int vfs_set_compression(const char* path, bool enable);
+// Does not descend into other file systems mounted beneath path
+int vfs_walk(const char* path, vfs_walk_fn visit, void* context);
+
+// Flush every mounted file system; 0 if all succeeded
+int vfs_sync(void);
+
+// Mount table
+int vfs_mount_count(void);
+const vfs_mount_t* vfs_get_mount(int index);
+
+const char* vfs_strerror(int error);
+
+#endif // VFS_H
@@ -0,0 +1,16 @@
+#ifndef VIRTIO_BLK_H
+#define VIRTIO_BLK_H
+
+#include "types.h"
+
+#define VIRTIO_BLK_MAX_DEVICES 2
+
+// Largest queue the driver has memory for (QEMU's default is 256)
+#define VIRTIO_BLK_MAX_QUEUE_SIZE 256
+
+// Find legacy virtio-blk PCI functions and register them as vda, vdb.
+// Requests are queued on a split virtqueue so a whole batch costs one
+// notify. Returns the number of devices registered.
+int virtio_blk_init(void);
+
+#endif // VIRTIO_BLK_H
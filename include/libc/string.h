@@ -9,6 +9,7 @@ void* memmove(void* dest, const void* src, size_t n);
 void* memset(void* s, int c, size_t n);
 int memcmp(const void* s1, const void* s2, size_t n);
 void* memchr(const void* s, int c, size_t n);
+void* memmem(const void* haystack, size_t haystack_len, const void* needle, size_t needle_len);
 
 // String manipulation
 size_t strlen(const char* s);
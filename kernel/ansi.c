@@ -0,0 +1,101 @@
+#include "../include/kernel/ansi.h"
+#include "../include/kernel/console.h"
+
+const uint8_t vga_ansi_color[8] = { 0, 4, 2, 6, 1, 5, 3, 7 };
+
+void ansi_init(ansi_parser_t* parser) {
+    parser->state = ANSI_NONE;
+    parser->count = 0;
+    parser->final = 0;
+}
+
+int ansi_feed(ansi_parser_t* parser, char c) {
+    if (parser->state == ANSI_NONE) {
+        if (c != '\033') {
+            return ANSI_TEXT;
+        }
+        parser->state = ANSI_START;
+        return ANSI_PENDING;
+    }
+
+    if (parser->state == ANSI_START) {
+        if (c == '[') {
+            parser->state = ANSI_CSI;
+            parser->count = 0;
+            parser->params[0] = 0;
+        } else {
+            parser->state = ANSI_NONE; // Not a CSI sequence: drop both
+        }
+        return ANSI_PENDING;
+    }
+
+    // count runs past ANSI_MAX_PARAMS while extra parameters are skipped
+    if (c >= '0' && c <= '9') {
+        if (parser->count == 0) {
+            parser->count = 1;
+        }
+        if (parser->count <= ANSI_MAX_PARAMS) {
+            parser->params[parser->count - 1] = parser->params[parser->count - 1] * 10 + (c - '0');
+        }
+        return ANSI_PENDING;
+    }
+    if (c == ';') {
+        if (parser->count == 0) {
+            parser->count = 1; // Leading ';': first parameter left empty
+        }
+        if (parser->count < ANSI_MAX_PARAMS) {
+            parser->params[parser->count] = 0;
+        }
+        parser->count++;
+        return ANSI_PENDING;
+    }
+
+    // Anything else ends the sequence
+    parser->state = ANSI_NONE;
+    if (parser->count > ANSI_MAX_PARAMS) {
+        parser->count = ANSI_MAX_PARAMS;
+    }
+    parser->final = c;
+    return ANSI_COMMAND;
+}
+
+uint8_t ansi_apply_sgr(const ansi_parser_t* parser, uint8_t attribute) {
+    uint8_t fg = attribute & 0x0F;
+    uint8_t bg = attribute >> 4;
+    bool bold = false;
+
+    if (parser->count == 0) {
+        return VGA_COLOR_LIGHT_GREY | VGA_COLOR_BLACK << 4; // ESC[m resets
+    }
+    for (size_t i = 0; i < parser->count; i++) {
+        uint32_t p = parser->params[i];
+        if (p == 0) {
+            fg = VGA_COLOR_LIGHT_GREY;
+            bg = VGA_COLOR_BLACK;
+        } else if (p == 1) {
+            bold = true;
+        } else if (p >= 30 && p <= 37) {
+            fg = vga_ansi_color[p - 30];
+        } else if (p == 39) {
+            fg = VGA_COLOR_LIGHT_GREY;
+        } else if (p >= 40 && p <= 47) {
+            bg = vga_ansi_color[p - 40];
+        } else if (p == 49) {
+            bg = VGA_COLOR_BLACK;
+        } else if (p >= 90 && p <= 97) {
+            fg = vga_ansi_color[p - 90] | 8;
+        } else if (p >= 100 && p <= 107) {
+            bg = vga_ansi_color[p - 100] | 8;
+        }
+    }
+    if (bold) {
+        fg |= 8; // Bold shows as the bright colour
+    }
+    return fg | bg << 4;
+}
+
+void ansi_cursor_position(const ansi_parser_t* parser, size_t* row, size_t* col) {
+    // Rows and columns count from 1; missing or 0 means the first
+    *row = parser->count > 0 && parser->params[0] ? parser->params[0] - 1 : 0;
+    *col = parser->count > 1 && parser->params[1] ? parser->params[1] - 1 : 0;
+}
@@ -0,0 +1,341 @@
+#include "../include/kernel/ata.h"
+#include "../include/kernel/blockdev.h"
+#include "../include/kernel/interrupts.h"
+#include "../include/kernel/pci.h"
+#include "../include/kernel/system.h"
+#include "../include/libc/string.h"
+
+#ifndef TEST_MODE
+// Kernel mode only - legacy IDE ports plus PCI bus-master DMA
+
+// Task file registers (offsets from the channel I/O base)
+#define ATA_REG_DATA     0
+#define ATA_REG_ERROR    1
+#define ATA_REG_SECCOUNT 2
+#define ATA_REG_LBA0     3
+#define ATA_REG_LBA1     4
+#define ATA_REG_LBA2     5
+#define ATA_REG_DRIVE    6
+#define ATA_REG_STATUS   7
+#define ATA_REG_COMMAND  7
+
+// Status register bits
+#define ATA_SR_ERR  0x01
+#define ATA_SR_DRQ  0x08
+#define ATA_SR_DF   0x20
+#define ATA_SR_BSY  0x80
+
+// Commands
+#define ATA_CMD_READ_PIO    0x20
+#define ATA_CMD_WRITE_PIO   0x30
+#define ATA_CMD_READ_DMA    0xC8
+#define ATA_CMD_WRITE_DMA   0xCA
+#define ATA_CMD_CACHE_FLUSH 0xE7
+#define ATA_CMD_IDENTIFY    0xEC
+
+// Bus-master IDE registers (offsets from the channel's BMIDE base)
+#define BM_REG_COMMAND 0
+#define BM_REG_STATUS  2
+#define BM_REG_PRDT    4
+#define BM_CMD_START   0x01
+#define BM_CMD_READ    0x08  // Device to memory
+#define BM_STATUS_ERROR 0x02
+#define BM_STATUS_IRQ   0x04
+
+#define ATA_PRD_END_OF_TABLE 0x8000
+#define ATA_POLL_LIMIT 1000000
+#define ATA_TIMEOUT_TICKS (2 * SYSTEM_TIMER_HZ)
+
+typedef struct {
+    uint16_t io_base;
+    uint16_t ctrl_base;
+    uint16_t bmide_base;   // 0 when bus-master DMA is unavailable
+    uint8_t irq;
+    volatile bool irq_fired;
+} ata_channel_t;
+
+typedef struct {
+    ata_channel_t* channel;
+    uint8_t slave;
+    bool dma;
+    block_device_t dev;
+} ata_drive_t;
+
+// Physical region descriptor; paging is off so addresses are physical
+typedef struct {
+    uint32_t address;
+    uint16_t byte_count;   // 0 means 64 KB
+    uint16_t flags;
+} __attribute__((packed)) ata_prd_t;
+
+static ata_channel_t channels[2] = {
+    { 0x1F0, 0x3F6, 0, IRQ_ATA_PRIMARY, false },
+    { 0x170, 0x376, 0, IRQ_ATA_SECONDARY, false },
+};
+static ata_drive_t drives[ATA_MAX_DRIVES];
+static int num_drives = 0;
+
+// A single PRD covers the bounce buffer, which must not cross a 64 KB line
+static ata_prd_t prd_table[1] __attribute__((aligned(8)));
+static uint8_t dma_buffer[ATA_MAX_TRANSFER_SECTORS * BLOCKDEV_SECTOR_SIZE] __attribute__((aligned(65536)));
+
+// Reading the alternate status register four times gives the 400ns settle
+static void ata_delay(ata_channel_t* ch) {
+    for (int i = 0; i < 4; i++) {
+        inb(ch->ctrl_base);
+    }
+}
+
+static int ata_wait_not_busy(ata_channel_t* ch) {
+    for (int i = 0; i < ATA_POLL_LIMIT; i++) {
+        uint8_t status = inb(ch->io_base + ATA_REG_STATUS);
+        if (!(status & ATA_SR_BSY)) {
+            return (status & (ATA_SR_ERR | ATA_SR_DF)) ? -1 : 0;
+        }
+    }
+    return -2; // Timed out
+}
+
+static int ata_wait_data(ata_channel_t* ch) {
+    for (int i = 0; i < ATA_POLL_LIMIT; i++) {
+        uint8_t status = inb(ch->io_base + ATA_REG_STATUS);
+        if (status & (ATA_SR_ERR | ATA_SR_DF)) {
+            return -1;
+        }
+        if (!(status & ATA_SR_BSY) && (status & ATA_SR_DRQ)) {
+            return 0;
+        }
+    }
+    return -2; // Timed out
+}
+
+// Program drive, LBA28 address and sector count (0 means 256)
+static void ata_select(ata_drive_t* d, uint32_t lba, uint32_t count) {
+    ata_channel_t* ch = d->channel;
+    outb(ch->io_base + ATA_REG_DRIVE, 0xE0 | (d->slave << 4) | ((lba >> 24) & 0x0F));
+    ata_delay(ch);
+    outb(ch->io_base + ATA_REG_SECCOUNT, count & 0xFF);
+    outb(ch->io_base + ATA_REG_LBA0, lba & 0xFF);
+    outb(ch->io_base + ATA_REG_LBA1, (lba >> 8) & 0xFF);
+    outb(ch->io_base + ATA_REG_LBA2, (lba >> 16) & 0xFF);
+}
+
+// Make the drive's write cache durable before a write is reported done
+static int ata_flush_cache(ata_channel_t* ch) {
+    outb(ch->io_base + ATA_REG_COMMAND, ATA_CMD_CACHE_FLUSH);
+    return ata_wait_not_busy(ch);
+}
+
+static int ata_pio_transfer(ata_drive_t* d, uint32_t lba, uint32_t count, void* buffer, bool write) {
+    ata_channel_t* ch = d->channel;
+    uint16_t* words = (uint16_t*)buffer;
+    
+    if (ata_wait_not_busy(ch) != 0) {
+        return -1;
+    }
+    
+    ata_select(d, lba, count);
+    outb(ch->io_base + ATA_REG_COMMAND, write ? ATA_CMD_WRITE_PIO : ATA_CMD_READ_PIO);
+    
+    for (uint32_t i = 0; i < count; i++) {
+        if (ata_wait_data(ch) != 0) {
+            return -1;
+        }
+        if (write) {
+            outsw(ch->io_base + ATA_REG_DATA, words, 256);
+        } else {
+            insw(ch->io_base + ATA_REG_DATA, words, 256);
+        }
+        words += 256;
+    }
+    
+    return write ? ata_flush_cache(ch) : 0;
+}
+
+static int ata_dma_transfer(ata_drive_t* d, uint32_t lba, uint32_t count, void* buffer, bool write) {
+    ata_channel_t* ch = d->channel;
+    uint16_t bm = ch->bmide_base;
+    uint32_t bytes = count * BLOCKDEV_SECTOR_SIZE;
+    uint8_t direction = write ? 0 : BM_CMD_READ;
+    
+    if (write) {
+        memcpy(dma_buffer, buffer, bytes);
+    }
+    
+    prd_table[0].address = (uint32_t)dma_buffer;
+    prd_table[0].byte_count = bytes & 0xFFFF;
+    prd_table[0].flags = ATA_PRD_END_OF_TABLE;
+    
+    // Stop any previous transfer, load the PRD table, clear IRQ/error bits
+    outb(bm + BM_REG_COMMAND, 0);
+    outl(bm + BM_REG_PRDT, (uint32_t)prd_table);
+    outb(bm + BM_REG_STATUS, inb(bm + BM_REG_STATUS) | BM_STATUS_ERROR | BM_STATUS_IRQ);
+    outb(bm + BM_REG_COMMAND, direction);
+    
+    if (ata_wait_not_busy(ch) != 0) {
+        return -1;
+    }
+    
+    ch->irq_fired = false;
+    ata_select(d, lba, count);
+    outb(ch->io_base + ATA_REG_COMMAND, write ? ATA_CMD_WRITE_DMA : ATA_CMD_READ_DMA);
+    outb(bm + BM_REG_COMMAND, direction | BM_CMD_START);
+    
+    // The controller moves the data; the CPU sleeps until the completion IRQ
+    uint32_t deadline = system_get_uptime() + ATA_TIMEOUT_TICKS;
+    bool enabled = irq_save();
+    while (!ch->irq_fired && (int32_t)(deadline - system_get_uptime()) > 0) {
+        cpu_idle();
+    }
+    irq_restore(enabled);
+    
+    outb(bm + BM_REG_COMMAND, 0);
+    uint8_t bm_status = inb(bm + BM_REG_STATUS);
+    uint8_t status = inb(ch->io_base + ATA_REG_STATUS);
+    outb(bm + BM_REG_STATUS, bm_status | BM_STATUS_ERROR | BM_STATUS_IRQ);
+    
+    if (!ch->irq_fired || (bm_status & BM_STATUS_ERROR) || (status & (ATA_SR_ERR | ATA_SR_DF))) {
+        return -1;
+    }
+    
+    if (write) {
+        return ata_flush_cache(ch);
+    }
+    memcpy(buffer, dma_buffer, bytes);
+    return 0;
+}
+
+static int ata_transfer(ata_drive_t* d, uint32_t lba, uint32_t count, void* buffer, bool write) {
+    uint8_t* bytes = (uint8_t*)buffer;
+    
+    while (count > 0) {
+        uint32_t chunk = count < ATA_MAX_TRANSFER_SECTORS ? count : ATA_MAX_TRANSFER_SECTORS;
+        
+        int result = -1;
+        if (d->dma) {
+            result = ata_dma_transfer(d, lba, chunk, bytes, write);
+            if (result != 0) {
+                // Controller or drive refused DMA - stay on PIO from now on
+                d->dma = false;
+                d->dev.driver = "ata-pio";
+            }
+        }
+        if (result != 0 && ata_pio_transfer(d, lba, chunk, bytes, write) != 0) {
+            return -1;
+        }
+        
+        lba += chunk;
+        count -= chunk;
+        bytes += chunk * BLOCKDEV_SECTOR_SIZE;
+    }
+    return 0;
+}
+
+static int ata_read(block_device_t* dev, uint32_t lba, uint32_t count, void* buffer) {
+    return ata_transfer((ata_drive_t*)dev->driver_data, lba, count, buffer, false);
+}
+
+static int ata_write(block_device_t* dev, uint32_t lba, uint32_t count, const void* buffer) {
+    return ata_transfer((ata_drive_t*)dev->driver_data, lba, count, (void*)buffer, true);
+}
+
+static void ata_irq(interrupt_frame_t* frame) {
+    ata_channel_t* ch = (frame->vector - IRQ_BASE_VECTOR == IRQ_ATA_PRIMARY) ? &channels[0] : &channels[1];
+    inb(ch->io_base + ATA_REG_STATUS); // Reading status acknowledges the drive
+    ch->irq_fired = true;
+}
+
+static bool ata_identify(ata_channel_t* ch, uint8_t slave, uint16_t* id) {
+    outb(ch->io_base + ATA_REG_DRIVE, 0xA0 | (slave << 4));
+    ata_delay(ch);
+    outb(ch->io_base + ATA_REG_SECCOUNT, 0);
+    outb(ch->io_base + ATA_REG_LBA0, 0);
+    outb(ch->io_base + ATA_REG_LBA1, 0);
+    outb(ch->io_base + ATA_REG_LBA2, 0);
+    outb(ch->io_base + ATA_REG_COMMAND, ATA_CMD_IDENTIFY);
+    
+    uint8_t status = inb(ch->io_base + ATA_REG_STATUS);
+    if (status == 0 || status == 0xFF) {
+        return false; // No drive (or floating bus)
+    }
+    
+    for (int i = 0; i < ATA_POLL_LIMIT && (inb(ch->io_base + ATA_REG_STATUS) & ATA_SR_BSY); i++) {
+    }
+    
+    // ATAPI and SATA bridges report a signature here instead of data
+    if (inb(ch->io_base + ATA_REG_LBA1) != 0 || inb(ch->io_base + ATA_REG_LBA2) != 0) {
+        return false;
+    }
+    
+    if (ata_wait_data(ch) != 0) {
+        return false;
+    }
+    
+    insw(ch->io_base + ATA_REG_DATA, id, 256);
+    return true;
+}
+
+int ata_init(void) {
+    // Bus-master DMA registers live behind BAR4 of the PCI IDE controller
+    const pci_device_t* ide = pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_IDE);
+    uint16_t bmide = 0;
+    if (ide != NULL) {
+        uint32_t bar4 = pci_config_read32(ide->addr, PCI_BAR4);
+        if (bar4 & 1) {
+            bmide = bar4 & 0xFFFC;
+            pci_enable_bus_master(ide->addr);
+        }
+    }
+    channels[0].bmide_base = bmide;
+    channels[1].bmide_base = bmide ? bmide + 8 : 0;
+    
+    for (int c = 0; c < 2; c++) {
+        ata_channel_t* ch = &channels[c];
+        bool found = false;
+        
+        if (inb(ch->io_base + ATA_REG_STATUS) == 0xFF) {
+            continue; // Nothing attached to this channel
+        }
+        
+        for (uint8_t slave = 0; slave < 2 && num_drives < ATA_MAX_DRIVES; slave++) {
+            uint16_t id[256];
+            if (!ata_identify(ch, slave, id)) {
+                continue;
+            }
+            
+            uint32_t sectors = id[60] | ((uint32_t)id[61] << 16);
+            if (sectors == 0) {
+                continue; // No LBA28 support
+            }
+            
+            ata_drive_t* d = &drives[num_drives];
+            d->channel = ch;
+            d->slave = slave;
+            d->dma = ch->bmide_base != 0 && (id[49] & (1 << 8));
+            
+            d->dev.name[0] = 'h';
+            d->dev.name[1] = 'd';
+            d->dev.name[2] = 'a' + c * 2 + slave;
+            d->dev.name[3] = '\0';
+            d->dev.driver = d->dma ? "ata-dma" : "ata-pio";
+            d->dev.sector_count = sectors;
+            d->dev.read = ata_read;
+            d->dev.write = ata_write;
+            d->dev.driver_data = d;
+            
+            if (blockdev_register(&d->dev) == 0) {
+                num_drives++;
+                found = true;
+            }
+        }
+        
+        if (found) {
+            irq_register_handler(ch->irq, ata_irq);
+            outb(ch->ctrl_base, 0); // nIEN clear: drives raise IRQs
+        }
+    }
+    
+    return num_drives;
+}
+
+#endif
@@ -0,0 +1,375 @@
+#include "../include/kernel/bcache.h"
+#include "../include/libc/string.h"
+
+static bcache_buffer_t buffers[BCACHE_NUM_BUFFERS];
+static bcache_buffer_t* hash_table[BCACHE_HASH_SIZE];
+static bcache_buffer_t* lru_head = NULL;
+static bcache_buffer_t* lru_tail = NULL;
+static bcache_stats_t stats;
+
+// Last miss, used to detect sequential access for read-ahead
+static block_device_t* last_miss_dev = NULL;
+static uint32_t last_miss_block = 0;
+
+// Contiguous staging area for read-ahead runs and coalesced write-back
+static uint8_t staging[BCACHE_FLUSH_BLOCKS * BCACHE_BLOCK_SIZE];
+
+static uint32_t bcache_hash(block_device_t* dev, uint32_t block) {
+    return (((uint32_t)dev >> 4) ^ (block * 2654435761u)) % BCACHE_HASH_SIZE;
+}
+
+static void lru_remove(bcache_buffer_t* buf) {
+    if (buf->lru_prev) buf->lru_prev->lru_next = buf->lru_next;
+    else lru_head = buf->lru_next;
+    if (buf->lru_next) buf->lru_next->lru_prev = buf->lru_prev;
+    else lru_tail = buf->lru_prev;
+}
+
+static void lru_push_front(bcache_buffer_t* buf) {
+    buf->lru_prev = NULL;
+    buf->lru_next = lru_head;
+    if (lru_head) lru_head->lru_prev = buf;
+    lru_head = buf;
+    if (!lru_tail) lru_tail = buf;
+}
+
+static void lru_touch(bcache_buffer_t* buf) {
+    if (lru_head != buf) {
+        lru_remove(buf);
+        lru_push_front(buf);
+    }
+}
+
+// Unlink a buffer from its chain, if it is on one, and forget its contents.
+// Claimed buffers are chained before their read completes, so membership
+// cannot be judged by BCACHE_VALID.
+static void hash_remove(bcache_buffer_t* buf) {
+    bcache_buffer_t** link = &hash_table[bcache_hash(buf->dev, buf->block)];
+    while (*link && *link != buf) {
+        link = &(*link)->hash_next;
+    }
+    if (*link) {
+        *link = buf->hash_next;
+    }
+    buf->hash_next = NULL;
+    buf->flags = 0;
+}
+
+static bcache_buffer_t* hash_lookup(block_device_t* dev, uint32_t block) {
+    bcache_buffer_t* buf = hash_table[bcache_hash(dev, block)];
+    while (buf && !(buf->dev == dev && buf->block == block)) {
+        buf = buf->hash_next;
+    }
+    // A buffer whose read failed holds nothing and does not count as a hit
+    if (buf && !(buf->flags & BCACHE_VALID)) {
+        return NULL;
+    }
+    return buf;
+}
+
+static bool block_in_range(block_device_t* dev, uint32_t block) {
+    return block < dev->sector_count / BCACHE_SECTORS_PER_BLOCK;
+}
+
+static int write_buffer(bcache_buffer_t* buf) {
+    if (blockdev_write(buf->dev, buf->block * BCACHE_SECTORS_PER_BLOCK,
+                       BCACHE_SECTORS_PER_BLOCK, buf->data) != 0) {
+        return -1;
+    }
+    buf->flags &= ~BCACHE_DIRTY;
+    stats.blocks_written++;
+    stats.write_requests++;
+    return 0;
+}
+
+// Take the least recently used unpinned buffer and bind it to (dev, block).
+// The returned buffer is pinned and holds no data yet.
+static bcache_buffer_t* claim_buffer(block_device_t* dev, uint32_t block) {
+    bcache_buffer_t* buf = lru_tail;
+    while (buf && buf->refcount > 0) {
+        buf = buf->lru_prev;
+    }
+    if (!buf) {
+        return NULL; // Every buffer is pinned
+    }
+
+    if ((buf->flags & BCACHE_DIRTY) && write_buffer(buf) != 0) {
+        return NULL;
+    }
+    if (buf->flags & BCACHE_VALID) {
+        stats.evictions++;
+    }
+    hash_remove(buf);
+
+    buf->dev = dev;
+    buf->block = block;
+    buf->refcount = 1;
+    uint32_t h = bcache_hash(dev, block);
+    buf->hash_next = hash_table[h];
+    hash_table[h] = buf;
+    lru_touch(buf);
+    return buf;
+}
+
+void bcache_init(void) {
+    memset(buffers, 0, sizeof(buffers));
+    memset(hash_table, 0, sizeof(hash_table));
+    memset(&stats, 0, sizeof(stats));
+    lru_head = NULL;
+    lru_tail = NULL;
+    last_miss_dev = NULL;
+
+    for (int i = 0; i < BCACHE_NUM_BUFFERS; i++) {
+        lru_push_front(&buffers[i]);
+    }
+}
+
+bcache_buffer_t* bcache_get(block_device_t* dev, uint32_t block) {
+    bcache_buffer_t* buf = hash_lookup(dev, block);
+    if (buf) {
+        stats.hits++;
+        buf->refcount++;
+        lru_touch(buf);
+        return buf;
+    }
+
+    if (!block_in_range(dev, block)) {
+        return NULL;
+    }
+    stats.misses++;
+
+    // A miss right after the previous one means a sequential scan: fetch
+    // the following uncached blocks with the same device request
+    uint32_t count = 1;
+    if (dev == last_miss_dev && block == last_miss_block + 1) {
+        while (count < BCACHE_READAHEAD_BLOCKS && block_in_range(dev, block + count) &&
+               !hash_lookup(dev, block + count)) {
+            count++;
+        }
+    }
+
+    bcache_buffer_t* run[BCACHE_READAHEAD_BLOCKS];
+    uint32_t claimed = 0;
+    while (claimed < count) {
+        run[claimed] = claim_buffer(dev, block + claimed);
+        if (!run[claimed]) {
+            break;
+        }
+        claimed++;
+    }
+    if (claimed == 0) {
+        return NULL;
+    }
+
+    uint8_t* target = (claimed == 1) ? run[0]->data : staging;
+    int result = blockdev_read(dev, block * BCACHE_SECTORS_PER_BLOCK,
+                               claimed * BCACHE_SECTORS_PER_BLOCK, target);
+
+    for (uint32_t i = 0; i < claimed; i++) {
+        if (result != 0) {
+            hash_remove(run[i]);
+            run[i]->refcount = 0;
+            continue;
+        }
+        if (claimed > 1) {
+            memcpy(run[i]->data, staging + i * BCACHE_BLOCK_SIZE, BCACHE_BLOCK_SIZE);
+        }
+        run[i]->flags = BCACHE_VALID;
+        if (i > 0) {
+            run[i]->refcount = 0; // Read-ahead blocks stay unpinned
+        }
+    }
+    if (result != 0) {
+        return NULL;
+    }
+
+    stats.readahead_blocks += claimed - 1;
+    last_miss_dev = dev;
+    last_miss_block = block + claimed - 1;
+    return run[0];
+}
+
+void bcache_release(bcache_buffer_t* buf) {
+    if (buf && buf->refcount > 0) {
+        buf->refcount--;
+    }
+}
+
+void bcache_mark_dirty(bcache_buffer_t* buf) {
+    buf->flags |= BCACHE_DIRTY;
+}
+
+// Split a position given as a sector plus a byte offset into a cache block
+// and the offset within it, without ever forming a byte address, which
+// would overflow 32 bits past 4 GB
+static void locate(uint32_t lba, uint32_t offset, uint32_t* block, uint32_t* within) {
+    uint32_t start = (lba % BCACHE_SECTORS_PER_BLOCK) * BLOCKDEV_SECTOR_SIZE;
+    *block = lba / BCACHE_SECTORS_PER_BLOCK + offset / BCACHE_BLOCK_SIZE;
+    *within = start + offset % BCACHE_BLOCK_SIZE;
+    if (*within >= BCACHE_BLOCK_SIZE) {
+        *block += 1;
+        *within -= BCACHE_BLOCK_SIZE;
+    }
+}
+
+int bcache_read(block_device_t* dev, uint32_t lba, uint32_t offset, void* buffer, size_t size) {
+    uint8_t* out = (uint8_t*)buffer;
+    uint32_t block, within;
+    locate(lba, offset, &block, &within);
+
+    while (size > 0) {
+        size_t chunk = BCACHE_BLOCK_SIZE - within;
+        if (chunk > size) chunk = size;
+
+        bcache_buffer_t* buf = bcache_get(dev, block);
+        if (!buf) {
+            return -1;
+        }
+        memcpy(out, buf->data + within, chunk);
+        bcache_release(buf);
+
+        out += chunk;
+        block++;
+        within = 0;
+        size -= chunk;
+    }
+    return 0;
+}
+
+int bcache_write(block_device_t* dev, uint32_t lba, uint32_t offset, const void* buffer, size_t size) {
+    const uint8_t* in = (const uint8_t*)buffer;
+    uint32_t block, within;
+    locate(lba, offset, &block, &within);
+
+    while (size > 0) {
+        size_t chunk = BCACHE_BLOCK_SIZE - within;
+        if (chunk > size) chunk = size;
+
+        // Whole-block overwrites skip reading the old contents
+        bcache_buffer_t* buf = hash_lookup(dev, block);
+        if (buf) {
+            buf->refcount++;
+            lru_touch(buf);
+            stats.hits++;
+        } else if (chunk == BCACHE_BLOCK_SIZE && block_in_range(dev, block)) {
+            buf = claim_buffer(dev, block);
+            if (buf) buf->flags = BCACHE_VALID;
+        } else {
+            buf = bcache_get(dev, block);
+        }
+        if (!buf) {
+            return -1;
+        }
+
+        memcpy(buf->data + within, in, chunk);
+        bcache_mark_dirty(buf);
+        bcache_release(buf);
+
+        in += chunk;
+        block++;
+        within = 0;
+        size -= chunk;
+    }
+    return 0;
+}
+
+int bcache_flush(block_device_t* dev) {
+    bcache_buffer_t* dirty[BCACHE_NUM_BUFFERS];
+    uint32_t num_dirty = 0;
+    int result = 0;
+
+    for (int i = 0; i < BCACHE_NUM_BUFFERS; i++) {
+        if ((buffers[i].flags & BCACHE_DIRTY) && (dev == NULL || buffers[i].dev == dev)) {
+            dirty[num_dirty++] = &buffers[i];
+        }
+    }
+
+    // Sort by device and block so adjacent blocks form runs
+    for (uint32_t i = 1; i < num_dirty; i++) {
+        bcache_buffer_t* key = dirty[i];
+        int j = i - 1;
+        while (j >= 0 && (dirty[j]->dev > key->dev ||
+               (dirty[j]->dev == key->dev && dirty[j]->block > key->block))) {
+            dirty[j + 1] = dirty[j];
+            j--;
+        }
+        dirty[j + 1] = key;
+    }
+
+    uint32_t i = 0;
+    while (i < num_dirty) {
+        block_device_t* batch_dev = dirty[i]->dev;
+        block_request_t requests[BCACHE_NUM_BUFFERS];
+        uint32_t run_start[BCACHE_NUM_BUFFERS];
+        uint32_t run_length[BCACHE_NUM_BUFFERS];
+        uint32_t num_requests = 0;
+        uint32_t staged = 0;
+
+        // One batch per device; single blocks are written from the buffer,
+        // longer runs are gathered into the staging area
+        while (i < num_dirty && dirty[i]->dev == batch_dev) {
+            uint32_t run = 1;
+            while (i + run < num_dirty && run < BCACHE_FLUSH_BLOCKS &&
+                   dirty[i + run]->dev == batch_dev &&
+                   dirty[i + run]->block == dirty[i]->block + run) {
+                run++;
+            }
+
+            void* data = dirty[i]->data;
+            if (run > 1) {
+                if (staged + run > BCACHE_FLUSH_BLOCKS) {
+                    break; // Staging full - next batch
+                }
+                data = staging + staged * BCACHE_BLOCK_SIZE;
+                for (uint32_t k = 0; k < run; k++) {
+                    memcpy(staging + (staged + k) * BCACHE_BLOCK_SIZE, dirty[i + k]->data, BCACHE_BLOCK_SIZE);
+                }
+                staged += run;
+            }
+
+            block_request_t* req = &requests[num_requests];
+            req->lba = dirty[i]->block * BCACHE_SECTORS_PER_BLOCK;
+            req->count = run * BCACHE_SECTORS_PER_BLOCK;
+            req->buffer = data;
+            req->write = true;
+            req->status = -1;   // Cleared by the driver only on completion
+            run_start[num_requests] = i;
+            run_length[num_requests] = run;
+            num_requests++;
+            i += run;
+        }
+
+        if (blockdev_submit(batch_dev, requests, num_requests) != 0) {
+            result = -1;
+        }
+
+        for (uint32_t r = 0; r < num_requests; r++) {
+            if (requests[r].status != 0) {
+                continue; // Stays dirty for the next flush
+            }
+            for (uint32_t k = 0; k < run_length[r]; k++) {
+                dirty[run_start[r] + k]->flags &= ~BCACHE_DIRTY;
+            }
+            stats.blocks_written += run_length[r];
+        }
+        stats.write_requests += num_requests;
+    }
+
+    return result;
+}
+
+void bcache_invalidate(block_device_t* dev) {
+    for (int i = 0; i < BCACHE_NUM_BUFFERS; i++) {
+        bcache_buffer_t* buf = &buffers[i];
+        if (buf->dev == dev && buf->refcount == 0 && !(buf->flags & BCACHE_DIRTY)) {
+            hash_remove(buf);
+        }
+    }
+    if (last_miss_dev == dev) {
+        last_miss_dev = NULL;
+    }
+}
+
+void bcache_get_stats(bcache_stats_t* out) {
+    *out = stats;
+}
@@ -0,0 +1,102 @@
+#include "../include/kernel/blockdev.h"
+#include "../include/libc/string.h"
+
+static block_device_t* devices[BLOCKDEV_MAX_DEVICES];
+static int num_devices = 0;
+
+int blockdev_register(block_device_t* dev) {
+    if (num_devices >= BLOCKDEV_MAX_DEVICES) {
+        return -1; // Device table full
+    }
+    
+    if (blockdev_get(dev->name) != NULL) {
+        return -2; // Name already taken
+    }
+    
+    devices[num_devices++] = dev;
+    return 0;
+}
+
+block_device_t* blockdev_get(const char* name) {
+    for (int i = 0; i < num_devices; i++) {
+        if (strcmp(devices[i]->name, name) == 0) {
+            return devices[i];
+        }
+    }
+    return NULL;
+}
+
+block_device_t* blockdev_get_index(int index) {
+    if (index < 0 || index >= num_devices) {
+        return NULL;
+    }
+    return devices[index];
+}
+
+int blockdev_count(void) {
+    return num_devices;
+}
+
+int blockdev_read(block_device_t* dev, uint32_t lba, uint32_t count, void* buffer) {
+    if (lba >= dev->sector_count || count > dev->sector_count - lba) {
+        return -1; // Past the end of the device
+    }
+    
+    dev->read_requests++;
+    dev->sectors_read += count;
+    return dev->read(dev, lba, count, buffer);
+}
+
+int blockdev_write(block_device_t* dev, uint32_t lba, uint32_t count, const void* buffer) {
+    if (lba >= dev->sector_count || count > dev->sector_count - lba) {
+        return -1; // Past the end of the device
+    }
+    
+    if (dev->write == NULL) {
+        return -2; // Read-only device
+    }
+    
+    dev->write_requests++;
+    dev->sectors_written += count;
+    return dev->write(dev, lba, count, buffer);
+}
+
+int blockdev_submit(block_device_t* dev, block_request_t* requests, uint32_t count) {
+    int result = 0;
+    
+    for (uint32_t i = 0; i < count; i++) {
+        block_request_t* req = &requests[i];
+        if (req->lba >= dev->sector_count || req->count > dev->sector_count - req->lba) {
+            return -1; // Past the end of the device
+        }
+        if (req->write && dev->write == NULL) {
+            return -2; // Read-only device
+        }
+        
+        if (req->write) {
+            dev->write_requests++;
+            dev->sectors_written += req->count;
+        } else {
+            dev->read_requests++;
+            dev->sectors_read += req->count;
+        }
+    }
+    
+    if (dev->submit) {
+        return dev->submit(dev, requests, count);
+    }
+    
+    // No queueing support: issue the requests one at a time
+    for (uint32_t i = 0; i < count; i++) {
+        block_request_t* req = &requests[i];
+        if (req->write) {
+            req->status = dev->write(dev, req->lba, req->count, req->buffer);
+        } else {
+            req->status = dev->read(dev, req->lba, req->count, req->buffer);
+        }
+        if (req->status != 0) {
+            result = req->status;
+        }
+    }
+    return result;
+}
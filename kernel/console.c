@@ -1,4 +1,6 @@
 #include "../include/kernel/console.h"
+#include "../include/kernel/ansi.h"
+#include "../include/kernel/scrollback.h"
 #include "../include/kernel/system.h"
 #include "../include/libc/string.h"
 
@@ -6,40 +8,74 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-// Test mode - use standard I/O
+// Test mode - use standard I/O. Output collects in a buffer that is
+// written out when full, when the shell waits for input (console_flush)
+// and at exit, rather than with one write per character.
+#define CONSOLE_OUTPUT_SIZE 4096
+
 static enum vga_color current_fg = VGA_COLOR_LIGHT_GREY;
 static enum vga_color current_bg = VGA_COLOR_BLACK;
+static char output[CONSOLE_OUTPUT_SIZE];
+static size_t output_used = 0;
+static bool flush_at_exit = false;
+
+void console_flush(void) {
+    if (output_used > 0) {
+        fwrite(output, 1, output_used, stdout);
+        output_used = 0;
+    }
+    fflush(stdout);
+}
+
+static void console_emit(const char* data, size_t size) {
+    if (!flush_at_exit) {
+        atexit(console_flush);
+        flush_at_exit = true;
+    }
+    if (output_used + size > sizeof(output)) {
+        console_flush();
+        if (size > sizeof(output)) {
+            fwrite(data, 1, size, stdout);
+            return;
+        }
+    }
+    memcpy(output + output_used, data, size);
+    output_used += size;
+}
 
 void console_init(void) {
-    printf("\033[2J\033[H"); // Clear screen and move cursor to home
+    console_write("\033[2J\033[H"); // Clear screen and move cursor to home
 }
 
 void console_clear(void) {
-    printf("\033[2J\033[H"); // Clear screen and move cursor to home
+    console_write("\033[2J\033[H"); // Clear screen and move cursor to home
 }
 
 void console_set_color(enum vga_color fg, enum vga_color bg) {
     current_fg = fg;
     current_bg = bg;
     // Set ANSI color codes
-    printf("\033[%d;%dm", 30 + fg, 40 + bg);
+    char sequence[16];
+    snprintf(sequence, sizeof(sequence), "\033[%d;%dm", (fg & 8 ? 90 : 30) + vga_ansi_color[fg & 7],
+             (bg & 8 ? 100 : 40) + vga_ansi_color[bg & 7]);
+    console_write(sequence);
 }
 
 void console_putchar(char c) {
-    putchar(c);
-    fflush(stdout);
+    console_emit(&c, 1);
 }
 
 void console_write(const char* data) {
-    printf("%s", data);
-    fflush(stdout);
+    console_emit(data, strlen(data));
 }
 
 void console_write_size(const char* data, size_t size) {
-    for (size_t i = 0; i < size; i++) {
-        putchar(data[i]);
-    }
-    fflush(stdout);
+    console_emit(data, size);
+}
+
+void console_scroll_view(int lines) {
+    // The terminal keeps its own history
+    (void)lines;
 }
 
 void console_get_cursor(size_t* row, size_t* col) {
@@ -48,25 +84,112 @@ void console_get_cursor(size_t* row, size_t* col) {
 }
 
 void console_set_cursor(size_t row, size_t col) {
-    printf("\033[%zu;%zuH", row + 1, col + 1);
+    char sequence[24];
+    snprintf(sequence, sizeof(sequence), "\033[%u;%uH", (unsigned)row + 1, (unsigned)col + 1);
+    console_write(sequence);
+}
+
+void console_set_outputs(unsigned outputs) {
+    // Everything goes to stdout
+    (void)outputs;
+}
+
+int console_use_framebuffer(const console_framebuffer_t* fb) {
+    (void)fb;
+    return -1;
 }
 
 #else
-// Kernel mode - use VGA text mode
+// Kernel mode - use VGA text mode, or a framebuffer the boot loader set up
+#include "../include/kernel/font.h"
+#include "../include/kernel/serial.h"
+#include "../include/libc/stdio.h"
 
 // Forward declaration
 void console_putchar(char c);
 
-// VGA text mode constants
-static const size_t VGA_WIDTH = 80;
-static const size_t VGA_HEIGHT = 25;
+// VGA text mode is 80x25; on a framebuffer the console is as large as the
+// mode allows, up to CONSOLE_MAX_WIDTH x CONSOLE_MAX_HEIGHT
+#define VGA_WIDTH 80
+#define VGA_HEIGHT 25
+#define CONSOLE_MAX_WIDTH SCROLLBACK_MAX_WIDTH  // 160, the widest row it can save
+#define CONSOLE_MAX_HEIGHT 64
+static size_t console_width = VGA_WIDTH;
+static size_t console_height = VGA_HEIGHT;
 static uint16_t* const VGA_MEMORY = (uint16_t*) 0xB8000;
 
+// Text memory holds 32 KB, far more than one screen. Scrolling moves the
+// CRTC start address down a line instead of copying the screen, and only
+// copies when the window reaches the end of memory.
+#define VGA_MEMORY_CELLS 16384
+#define VGA_MEMORY_ROWS 204     // Whole 80-column rows in text memory
+#define VGA_CRTC_INDEX 0x3D4
+#define VGA_CRTC_DATA 0x3D5
+#define VGA_CRTC_START_HIGH 0x0C
+#define VGA_CRTC_START_LOW 0x0D
+
 // Console state
 static size_t console_row;
 static size_t console_column;
 static uint8_t console_color;
-static uint16_t* console_buffer;
+static uint16_t* console_buffer;   // Top left of the visible window
+static size_t console_origin;      // Cell offset of console_buffer in VGA memory
+
+// Output is drawn into a copy of text memory in RAM. console_flush copies
+// the rows changed since the last flush to VGA memory a word at a time,
+// then moves the display start, so a burst of output writes each visible
+// row once.
+static uint16_t console_shadow[VGA_MEMORY_CELLS] __attribute__((aligned(4)));
+typedef uint32_t __attribute__((may_alias)) cell_pair_t; // Two cells at once
+static uint32_t console_dirty[(VGA_MEMORY_ROWS + 31) / 32];
+static size_t displayed_origin;
+
+// On a framebuffer, cells are drawn as glyphs straight into video memory
+// in its own pixel format. fb_cells records what each screen cell shows,
+// so console_flush only draws the cells that differ - after a scroll that
+// is every row, but blanks and repeated text are still skipped.
+#define FB_CELL_NONE 0xFFFFFFFF  // Screen contents unknown
+
+static volatile uint8_t* fb_memory;   // NULL in VGA text mode
+static size_t fb_pitch;               // Bytes per scan line
+static size_t fb_pixel_bytes;         // 2, 3 or 4
+static uint32_t fb_palette[16];
+static uint32_t fb_cells[CONSOLE_MAX_WIDTH * CONSOLE_MAX_HEIGHT];
+static bool fb_scrolled;              // The window moved since the last flush
+
+// Glyph rows are drawn four pixels at a time from the sixteen 4-pixel
+// patterns in an attribute's colours: four pixels are fb_pixel_bytes
+// whole words in any of the formats. Patterns are kept for the few
+// attributes in use and worked out again when one is evicted.
+#define FB_PATTERN_SLOTS 16
+#define FB_PATTERN_NONE 0xFF
+typedef uint32_t fb_pattern_t[4];
+static fb_pattern_t fb_patterns[FB_PATTERN_SLOTS][16];
+static uint16_t fb_pattern_owner[FB_PATTERN_SLOTS];  // Attribute, or 0x100 if free
+static uint8_t fb_pattern_slot[256];                 // FB_PATTERN_NONE if not kept
+static size_t fb_pattern_next;
+
+// The 16 text mode colours as 0xRRGGBB
+static const uint32_t vga_rgb[16] = {
+    0x000000, 0x0000AA, 0x00AA00, 0x00AAAA, 0xAA0000, 0xAA00AA, 0xAA5500, 0xAAAAAA,
+    0x555555, 0x5555FF, 0x55FF55, 0x55FFFF, 0xFF5555, 0xFF55FF, 0xFFFF55, 0xFFFFFF,
+};
+
+// Serial outputs get the text as written, with newlines turned into CR LF
+// and colour and cursor changes sent as ANSI sequences
+static unsigned console_outputs = CONSOLE_OUTPUT_VGA;
+
+// Lines that scrolled off the top, and how far the display looks back
+static scrollback_t console_scrollback;
+static uint32_t scrollback_view;   // Lines the display is scrolled back; 0 = live
+
+// Escape sequence being parsed out of the written text
+static ansi_parser_t console_ansi;
+
+static inline void mark_dirty(size_t row) {
+    size_t memory_row = console_origin / console_width + row;
+    console_dirty[memory_row / 32] |= 1u << (memory_row % 32);
+}
 
 // Create a VGA entry
 static inline uint16_t vga_entry(unsigned char c, uint8_t color) {
@@ -78,52 +201,347 @@ static inline uint8_t vga_entry_color(enum vga_color fg, enum vga_color bg) {
     return fg | bg << 4;
 }
 
+// Move the window to start at cell origin; shown on the next flush
+static void console_set_origin(size_t origin) {
+    console_origin = origin;
+    console_buffer = console_shadow + origin;
+}
+
+static const fb_pattern_t* fb_pattern(uint8_t attribute) {
+    uint8_t slot = fb_pattern_slot[attribute];
+    if (slot != FB_PATTERN_NONE) {
+        return fb_patterns[slot];
+    }
+    
+    // Take the next slot in turn from whichever attribute held it
+    slot = fb_pattern_next++ % FB_PATTERN_SLOTS;
+    if (fb_pattern_owner[slot] < 256) {
+        fb_pattern_slot[fb_pattern_owner[slot]] = FB_PATTERN_NONE;
+    }
+    fb_pattern_owner[slot] = attribute;
+    fb_pattern_slot[attribute] = slot;
+    
+    uint32_t fg = fb_palette[attribute & 0x0F];
+    uint32_t bg = fb_palette[attribute >> 4];
+    for (int bits = 0; bits < 16; bits++) {
+        uint8_t pixels[sizeof(fb_pattern_t)];
+        for (size_t i = 0; i < 4; i++) {
+            uint32_t colour = bits & (8 >> i) ? fg : bg;
+            for (size_t b = 0; b < fb_pixel_bytes; b++) {
+                pixels[i * fb_pixel_bytes + b] = colour >> (8 * b);
+            }
+        }
+        memcpy(fb_patterns[slot][bits], pixels, 4 * fb_pixel_bytes);
+    }
+    return fb_patterns[slot];
+}
+
+// Draw a cell on the screen, a whole glyph row per pass
+static void fb_draw_cell(size_t x, size_t y, uint16_t cell) {
+    const fb_pattern_t* pattern = fb_pattern(cell >> 8);
+    const uint8_t* glyph = font_glyph(cell & 0xFF);
+    size_t words = fb_pixel_bytes;
+    volatile uint8_t* line = fb_memory + y * FONT_HEIGHT * fb_pitch + x * FONT_WIDTH * fb_pixel_bytes;
+    
+    for (size_t row = 0; row < FONT_HEIGHT; row++, line += fb_pitch) {
+        volatile uint32_t* dst = (volatile uint32_t*)line;
+        const uint32_t* left = pattern[glyph[row] >> 4];
+        const uint32_t* right = pattern[glyph[row] & 0x0F];
+        for (size_t i = 0; i < words; i++) {
+            dst[i] = left[i];
+            dst[words + i] = right[i];
+        }
+    }
+}
+
+// Draw the cells of screen row y that differ from what the screen shows
+static void fb_draw_row(size_t y, const uint16_t* cells) {
+    uint32_t* shown = fb_cells + y * console_width;
+    for (size_t x = 0; x < console_width; x++) {
+        if (shown[x] != cells[x]) {
+            shown[x] = cells[x];
+            fb_draw_cell(x, y, cells[x]);
+        }
+    }
+}
+
+// Show the window scrolled back by scrollback_view lines, straight onto the
+// display; the shadow buffer keeps the live screen
+static void scrollback_render(void) {
+    uint16_t line[CONSOLE_MAX_WIDTH];
+    
+    for (size_t y = 0; y < console_height; y++) {
+        const uint16_t* src = line;
+        if (y < scrollback_view) {
+            scrollback_decode(&console_scrollback, scrollback_view - 1 - y, line, console_width);
+        } else {
+            src = console_shadow + displayed_origin + (y - scrollback_view) * console_width;
+        }
+        
+        if (fb_memory) {
+            fb_draw_row(y, src);
+        } else {
+            volatile uint16_t* dst = VGA_MEMORY + displayed_origin + y * console_width;
+            for (size_t x = 0; x < console_width; x++) {
+                dst[x] = src[x];
+            }
+        }
+    }
+}
+
+void console_flush(void) {
+    // New output returns a scrolled-back display to the live screen
+    if (scrollback_view > 0) {
+        bool changed = console_origin != displayed_origin;
+        for (size_t i = 0; i < sizeof(console_dirty) / sizeof(console_dirty[0]); i++) {
+            changed |= console_dirty[i] != 0;
+        }
+        if (!changed) {
+            return;
+        }
+        scrollback_view = 0;
+        for (size_t y = 0; y < console_height; y++) {
+            mark_dirty(y);
+        }
+    }
+    
+    // Rows that scrolled out of the window are never shown again before
+    // being cleared, so only visible ones are copied
+    size_t first = console_origin / console_width;
+    if (fb_memory) {
+        // After a scroll every row sits somewhere new on the screen
+        for (size_t y = 0; y < console_height; y++) {
+            size_t row = first + y;
+            if (fb_scrolled || (console_dirty[row / 32] & (1u << (row % 32)))) {
+                fb_draw_row(y, console_shadow + row * console_width);
+            }
+        }
+        fb_scrolled = false;
+        memset(console_dirty, 0, sizeof(console_dirty));
+        displayed_origin = console_origin;
+        return;
+    }
+    
+    for (size_t row = first; row < first + console_height; row++) {
+        if (console_dirty[row / 32] & (1u << (row % 32))) {
+            const cell_pair_t* src = (const cell_pair_t*)(console_shadow + row * console_width);
+            volatile cell_pair_t* dst = (volatile cell_pair_t*)(VGA_MEMORY + row * console_width);
+            for (size_t i = 0; i < console_width / 2; i++) {
+                dst[i] = src[i];
+            }
+        }
+    }
+    memset(console_dirty, 0, sizeof(console_dirty));
+    
+    if (displayed_origin != console_origin) {
+        displayed_origin = console_origin;
+        outb(VGA_CRTC_INDEX, VGA_CRTC_START_HIGH);
+        outb(VGA_CRTC_DATA, (console_origin >> 8) & 0xFF);
+        outb(VGA_CRTC_INDEX, VGA_CRTC_START_LOW);
+        outb(VGA_CRTC_DATA, console_origin & 0xFF);
+    }
+}
+
+void console_scroll_view(int lines) {
+    console_flush();
+    
+    int view = (int)scrollback_view + lines;
+    if (view < 0) {
+        view = 0;
+    }
+    if (view > (int)console_scrollback.lines) {
+        view = console_scrollback.lines;
+    }
+    if ((uint32_t)view == scrollback_view) {
+        return;
+    }
+    
+    scrollback_view = view;
+    if (view > 0) {
+        scrollback_render();
+    } else {
+        for (size_t y = 0; y < console_height; y++) {
+            mark_dirty(y);
+        }
+        console_flush();
+    }
+}
+
+static void console_serial_write(const char* data, size_t size) {
+    while (size > 0) {
+        const char* newline = memchr(data, '\n', size);
+        if (!newline) {
+            serial_write(data, size);
+            return;
+        }
+        serial_write(data, newline - data);
+        serial_write("\r\n", 2);
+        size -= newline - data + 1;
+        data = newline + 1;
+    }
+}
+
+void console_set_outputs(unsigned outputs) {
+    if (!serial_present()) {
+        outputs &= ~CONSOLE_OUTPUT_SERIAL;
+    }
+    if (!outputs) {
+        outputs = CONSOLE_OUTPUT_VGA; // Never go silent
+    }
+    console_outputs = outputs;
+}
+
+int console_use_framebuffer(const console_framebuffer_t* fb) {
+    // 15 bits per pixel is stored in 16
+    size_t pixel_bytes = (fb->bpp + 7) / 8;
+    if (fb->bpp < 15 || fb->bpp > 32 || (fb->pitch % 4) != 0 ||
+        fb->width < VGA_WIDTH * FONT_WIDTH || fb->height < VGA_HEIGHT * FONT_HEIGHT) {
+        return -1;
+    }
+    
+    // An even width keeps every row aligned for the two-cell stores
+    console_width = (fb->width / FONT_WIDTH) & ~1u;
+    console_height = fb->height / FONT_HEIGHT;
+    if (console_width > CONSOLE_MAX_WIDTH) {
+        console_width = CONSOLE_MAX_WIDTH;
+    }
+    if (console_height > CONSOLE_MAX_HEIGHT) {
+        console_height = CONSOLE_MAX_HEIGHT;
+    }
+    
+    for (int i = 0; i < 16; i++) {
+        uint32_t r = vga_rgb[i] >> 16;
+        uint32_t g = (vga_rgb[i] >> 8) & 0xFF;
+        uint32_t b = vga_rgb[i] & 0xFF;
+        fb_palette[i] = (r >> (8 - fb->red_size)) << fb->red_position |
+                        (g >> (8 - fb->green_size)) << fb->green_position |
+                        (b >> (8 - fb->blue_size)) << fb->blue_position;
+    }
+    for (size_t i = 0; i < sizeof(fb_cells) / sizeof(fb_cells[0]); i++) {
+        fb_cells[i] = FB_CELL_NONE;
+    }
+    memset(fb_pattern_slot, FB_PATTERN_NONE, sizeof(fb_pattern_slot));
+    for (size_t i = 0; i < FB_PATTERN_SLOTS; i++) {
+        fb_pattern_owner[i] = 0x100;
+    }
+    fb_pixel_bytes = pixel_bytes;
+    fb_pitch = fb->pitch;
+    fb_memory = (volatile uint8_t*)fb->address;
+    return 0;
+}
+
 void console_init(void) {
     console_row = 0;
     console_column = 0;
     console_color = vga_entry_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
-    console_buffer = VGA_MEMORY;
+    ansi_init(&console_ansi);
+    scrollback_init(&console_scrollback);
+    displayed_origin = VGA_MEMORY_CELLS; // Unknown: program it on the first flush
     console_clear();
 }
 
-void console_clear(void) {
-    for (size_t y = 0; y < VGA_HEIGHT; y++) {
-        for (size_t x = 0; x < VGA_WIDTH; x++) {
-            const size_t index = y * VGA_WIDTH + x;
+// The screen-only halves of console_clear() and console_set_cursor(). The
+// escape parser calls these: the sequence it is parsing already goes to the
+// serial port as written, so echoing it there again would double it.
+static void console_clear_screen(void) {
+    console_set_origin(0);
+    for (size_t y = 0; y < console_height; y++) {
+        for (size_t x = 0; x < console_width; x++) {
+            const size_t index = y * console_width + x;
             console_buffer[index] = vga_entry(' ', console_color);
         }
+        mark_dirty(y);
     }
     console_row = 0;
     console_column = 0;
+    console_flush();
+}
+
+static void console_move_cursor(size_t row, size_t col) {
+    if (row < console_height && col < console_width) {
+        console_row = row;
+        console_column = col;
+    }
+}
+
+void console_clear(void) {
+    console_clear_screen();
+    if (console_outputs & CONSOLE_OUTPUT_SERIAL) {
+        serial_write("\033[2J\033[H", 7);
+    }
 }
 
 void console_set_color(enum vga_color fg, enum vga_color bg) {
     console_color = vga_entry_color(fg, bg);
+    
+    if (console_outputs & CONSOLE_OUTPUT_SERIAL) {
+        char sequence[16];
+        int length = snprintf(sequence, sizeof(sequence), "\033[%d;%dm",
+                              (fg & 8 ? 90 : 30) + vga_ansi_color[fg & 7],
+                              (bg & 8 ? 100 : 40) + vga_ansi_color[bg & 7]);
+        serial_write(sequence, length);
+    }
 }
 
 // Scroll the console up one line
 static void console_scroll(void) {
-    for (size_t y = 0; y < VGA_HEIGHT - 1; y++) {
-        for (size_t x = 0; x < VGA_WIDTH; x++) {
-            const size_t dst_index = y * VGA_WIDTH + x;
-            const size_t src_index = (y + 1) * VGA_WIDTH + x;
-            console_buffer[dst_index] = console_buffer[src_index];
+    scrollback_append(&console_scrollback, console_buffer, console_width);
+    if (fb_memory) {
+        fb_scrolled = true;
+    }
+    
+    size_t origin = console_origin + console_width;
+    if (origin + console_width * console_height <= VGA_MEMORY_CELLS) {
+        console_set_origin(origin);
+    } else {
+        // Out of memory below: move the lines that stay to the top
+        memmove(console_shadow, console_buffer + console_width, (console_height - 1) * console_width * sizeof(uint16_t));
+        console_set_origin(0);
+        for (size_t y = 0; y < console_height - 1; y++) {
+            mark_dirty(y);
         }
     }
     
     // Clear the last line
-    for (size_t x = 0; x < VGA_WIDTH; x++) {
-        const size_t index = (VGA_HEIGHT - 1) * VGA_WIDTH + x;
+    for (size_t x = 0; x < console_width; x++) {
+        const size_t index = (console_height - 1) * console_width + x;
         console_buffer[index] = vga_entry(' ', console_color);
     }
+    mark_dirty(console_height - 1);
 }
 
-void console_putchar(char c) {
+// Act on a completed escape sequence
+static void console_escape(void) {
+    char command = console_ansi.final;
+    if (command == 'm') {
+        console_color = ansi_apply_sgr(&console_ansi, console_color);
+    } else if (command == 'H' || command == 'f') {
+        size_t row, col;
+        ansi_cursor_position(&console_ansi, &row, &col);
+        console_move_cursor(row, col);
+    } else if (command == 'J' && console_ansi.count > 0 && console_ansi.params[0] == 2) {
+        size_t row = console_row;
+        size_t col = console_column;
+        console_clear_screen();
+        console_row = row;
+        console_column = col;
+    }
+}
+
+// Draw one character into the shadow buffer
+static void console_put(char c) {
+    if (console_ansi.state != ANSI_NONE || c == '\033') {
+        if (ansi_feed(&console_ansi, c) == ANSI_COMMAND) {
+            console_escape();
+        }
+        return;
+    }
+    
     if (c == '\n') {
         console_column = 0;
-        if (++console_row == VGA_HEIGHT) {
+        if (++console_row == console_height) {
             console_scroll();
-            console_row = VGA_HEIGHT - 1;
+            console_row = console_height - 1;
         }
         return;
     }
@@ -135,11 +553,11 @@ void console_putchar(char c) {
     
     if (c == '\t') {
         console_column = (console_column + 4) & ~3;
-        if (console_column >= VGA_WIDTH) {
+        if (console_column >= console_width) {
             console_column = 0;
-            if (++console_row == VGA_HEIGHT) {
+            if (++console_row == console_height) {
                 console_scroll();
-                console_row = VGA_HEIGHT - 1;
+                console_row = console_height - 1;
             }
         }
         return;
@@ -148,33 +566,86 @@ void console_putchar(char c) {
     if (c == '\b') {
         if (console_column > 0) {
             console_column--;
-            const size_t index = console_row * VGA_WIDTH + console_column;
+            const size_t index = console_row * console_width + console_column;
             console_buffer[index] = vga_entry(' ', console_color);
+            mark_dirty(console_row);
         }
         return;
     }
     
-    const size_t index = console_row * VGA_WIDTH + console_column;
+    const size_t index = console_row * console_width + console_column;
     console_buffer[index] = vga_entry(c, console_color);
+    mark_dirty(console_row);
     
-    if (++console_column == VGA_WIDTH) {
+    if (++console_column == console_width) {
         console_column = 0;
-        if (++console_row == VGA_HEIGHT) {
+        if (++console_row == console_height) {
             console_scroll();
-            console_row = VGA_HEIGHT - 1;
+            console_row = console_height - 1;
         }
     }
 }
 
-void console_write(const char* data) {
-    for (size_t i = 0; data[i] != '\0'; i++) {
-        console_putchar(data[i]);
+// Draw a string. Runs of characters other than controls are stored as
+// whole cells, two per 32-bit write, up to the end of the line; only
+// control characters take the per-character path.
+static void console_put_string(const char* data, size_t size) {
+    size_t i = 0;
+    
+    while (i < size) {
+        if ((unsigned char)data[i] < ' ' || console_ansi.state != ANSI_NONE) {
+            console_put(data[i++]);
+            continue;
+        }
+        
+        const uint32_t color = (uint32_t)console_color << 8;
+        size_t end = i + (console_width - console_column);
+        if (end > size) {
+            end = size;
+        }
+        uint16_t* cell = console_buffer + console_row * console_width + console_column;
+        size_t start = i;
+        
+        if ((console_column & 1) && i < end && (unsigned char)data[i] >= ' ') {
+            *cell++ = color | (unsigned char)data[i++];
+        }
+        while (i + 1 < end && (unsigned char)data[i] >= ' ' && (unsigned char)data[i + 1] >= ' ') {
+            *(cell_pair_t*)cell = (color | (unsigned char)data[i]) |
+                               ((color | (unsigned char)data[i + 1]) << 16);
+            cell += 2;
+            i += 2;
+        }
+        if (i < end && (unsigned char)data[i] >= ' ') {
+            *cell++ = color | (unsigned char)data[i++];
+        }
+        
+        mark_dirty(console_row);
+        console_column += i - start;
+        if (console_column == console_width) {
+            console_column = 0;
+            if (++console_row == console_height) {
+                console_scroll();
+                console_row = console_height - 1;
+            }
+        }
     }
 }
 
+void console_putchar(char c) {
+    console_write_size(&c, 1);
+}
+
+void console_write(const char* data) {
+    console_write_size(data, strlen(data));
+}
+
 void console_write_size(const char* data, size_t size) {
-    for (size_t i = 0; i < size; i++) {
-        console_putchar(data[i]);
+    if (console_outputs & CONSOLE_OUTPUT_VGA) {
+        console_put_string(data, size);
+        console_flush();
+    }
+    if (console_outputs & CONSOLE_OUTPUT_SERIAL) {
+        console_serial_write(data, size);
     }
 }
 
@@ -184,9 +655,15 @@ void console_get_cursor(size_t* row, size_t* col) {
 }
 
 void console_set_cursor(size_t row, size_t col) {
-    if (row < VGA_HEIGHT && col < VGA_WIDTH) {
-        console_row = row;
-        console_column = col;
+    if (row < console_height && col < console_width) {
+        console_move_cursor(row, col);
+        
+        if (console_outputs & CONSOLE_OUTPUT_SERIAL) {
+            char sequence[24];
+            int length = snprintf(sequence, sizeof(sequence), "\033[%u;%uH",
+                                  (unsigned)row + 1, (unsigned)col + 1);
+            serial_write(sequence, length);
+        }
     }
 }
 
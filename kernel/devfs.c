@@ -0,0 +1,140 @@
+#include "../include/kernel/vfs.h"
+#include "../include/kernel/bcache.h"
+#include "../include/kernel/blockdev.h"
+#include "../include/kernel/console.h"
+#include "../include/libc/string.h"
+
+// devfs: character devices from a fixed table plus every registered block
+// device. Nothing is stored; reads and writes go straight to the device.
+
+typedef enum {
+    DEV_NULL,
+    DEV_ZERO,
+    DEV_CONSOLE,
+} char_device_t;
+
+static const struct {
+    const char* name;
+    char_device_t type;
+} char_devices[] = {
+    { "null", DEV_NULL },
+    { "zero", DEV_ZERO },
+    { "console", DEV_CONSOLE },
+};
+
+#define NUM_CHAR_DEVICES (sizeof(char_devices) / sizeof(char_devices[0]))
+
+static int find_char_device(const char* name) {
+    for (uint32_t i = 0; i < NUM_CHAR_DEVICES; i++) {
+        if (strcmp(char_devices[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int devfs_stat(vfs_mount_t* mnt, const char* path, vfs_stat_t* st) {
+    (void)mnt;
+    memset(st, 0, sizeof(vfs_stat_t));
+    if (strcmp(path, "/") == 0) {
+        st->is_directory = true;
+        st->permissions = 0755;
+        return 0;
+    }
+
+    block_device_t* dev = blockdev_get(path + 1);
+    if (dev) {
+        uint64_t capacity = (uint64_t)dev->sector_count * BLOCKDEV_SECTOR_SIZE;
+        st->size = capacity > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)capacity;
+        st->permissions = 0440;
+        return 0;
+    }
+    if (find_char_device(path + 1) >= 0) {
+        st->permissions = 0666;
+        return 0;
+    }
+    return VFS_ENOENT;
+}
+
+static int devfs_read(vfs_mount_t* mnt, const char* path, uint32_t offset, void* buffer, size_t size) {
+    (void)mnt;
+    if (strcmp(path, "/") == 0) {
+        return VFS_EISDIR;
+    }
+
+    block_device_t* dev = blockdev_get(path + 1);
+    if (dev) {
+        // Byte offsets only reach the first 4 GB; the capacity may not fit
+        uint64_t capacity = (uint64_t)dev->sector_count * BLOCKDEV_SECTOR_SIZE;
+        if (offset >= capacity) {
+            return 0;
+        }
+        if (size > capacity - offset) {
+            size = capacity - offset;
+        }
+        return bcache_read(dev, offset / BLOCKDEV_SECTOR_SIZE, offset % BLOCKDEV_SECTOR_SIZE,
+                           buffer, size) == 0 ? (int)size : VFS_EIO;
+    }
+
+    int index = find_char_device(path + 1);
+    if (index < 0) {
+        return VFS_ENOENT;
+    }
+    if (char_devices[index].type == DEV_ZERO) {
+        memset(buffer, 0, size);
+        return size;
+    }
+    return 0; // null and console are always at end of file
+}
+
+static int devfs_write(vfs_mount_t* mnt, const char* path, const void* data, size_t size) {
+    (void)mnt;
+    if (blockdev_get(path + 1)) {
+        return VFS_EROFS; // Raw disk writes would bypass the file systems on them
+    }
+
+    int index = find_char_device(path + 1);
+    if (index < 0) {
+        return VFS_ENOENT;
+    }
+    if (char_devices[index].type == DEV_CONSOLE) {
+        console_write_size((const char*)data, size);
+    }
+    return 0;
+}
+
+static int devfs_list(vfs_mount_t* mnt, const char* path, char* buffer, size_t size) {
+    (void)mnt;
+    if (strcmp(path, "/") != 0) {
+        return VFS_ENOENT;
+    }
+
+    size_t offset = 0;
+    int count = blockdev_count();
+    for (int i = 0; i < (int)NUM_CHAR_DEVICES + count; i++) {
+        const char* name = i < (int)NUM_CHAR_DEVICES ? char_devices[i].name
+                                                     : blockdev_get_index(i - NUM_CHAR_DEVICES)->name;
+        size_t len = strlen(name);
+        if (offset + len + 2 > size) {
+            break;
+        }
+        strcpy(buffer + offset, name);
+        offset += len;
+        buffer[offset++] = '\n';
+    }
+
+    if (offset > 0) {
+        buffer[offset - 1] = '\0';
+    } else {
+        buffer[0] = '\0';
+    }
+    return offset;
+}
+
+const vfs_ops_t devfs_ops = {
+    .name = "devfs",
+    .stat = devfs_stat,
+    .read = devfs_read,
+    .write = devfs_write,
+    .list = devfs_list,
+};
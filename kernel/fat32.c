@@ -0,0 +1,589 @@
+#include "../include/kernel/fat32.h"
+#include "../include/kernel/bcache.h"
+#include "../include/kernel/vfs.h"
+#include "../include/libc/string.h"
+
+#define SECTOR_SIZE BLOCKDEV_SECTOR_SIZE
+#define FAT32_EOC 0x0FFFFFF8        // Cluster values from here on end a chain
+#define FAT32_ENTRY_MASK 0x0FFFFFFF
+#define ENTRIES_PER_SECTOR (SECTOR_SIZE / 32)
+
+static fat32_volume_t volumes[FAT32_MAX_VOLUMES];
+static int num_volumes = 0;
+
+static uint16_t read16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t read32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static char to_lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+// FAT names compare case-insensitively
+static bool name_equal(const char* a, const char* b) {
+    while (*a && *b) {
+        if (to_lower(*a++) != to_lower(*b++)) {
+            return false;
+        }
+    }
+    return *a == *b;
+}
+
+static uint32_t cluster_to_sector(fat32_volume_t* vol, uint32_t cluster) {
+    return vol->data_start + (cluster - 2) * vol->sectors_per_cluster;
+}
+
+static bool cluster_valid(fat32_volume_t* vol, uint32_t cluster) {
+    return cluster >= 2 && cluster < vol->cluster_count + 2;
+}
+
+#define FAT_WINDOW_EMPTY 0xFFFFFFFF  // No sector loaded; sector 0 is a real one
+
+// FAT lookups go through a one-sector window, so walking a chain touches
+// the buffer cache once per 128 entries rather than once per cluster
+typedef struct {
+    uint32_t sector;
+    uint8_t data[SECTOR_SIZE];
+} fat_window_t;
+
+static int fat_next(fat32_volume_t* vol, fat_window_t* window, uint32_t cluster, uint32_t* next) {
+    uint32_t sector = vol->fat_start + cluster / (SECTOR_SIZE / 4);
+    if (window->sector != sector) {
+        if (bcache_read(vol->dev, sector, 0, window->data, SECTOR_SIZE) != 0) {
+            return -1;
+        }
+        window->sector = sector;
+    }
+    *next = read32(window->data + (cluster % (SECTOR_SIZE / 4)) * 4) & FAT32_ENTRY_MASK;
+    return 0;
+}
+
+// Extend a run starting at cluster for as long as the chain stays
+// contiguous; *next receives the cluster after the run
+static int walk_run(fat32_volume_t* vol, fat_window_t* window, uint32_t cluster,
+                    fat32_run_t* run, uint32_t* next) {
+    run->cluster = cluster;
+    run->count = 1;
+    for (;;) {
+        if (fat_next(vol, window, cluster, next) != 0) {
+            return -1;
+        }
+        if (*next != cluster + 1 || run->count >= vol->cluster_count) {
+            return 0;
+        }
+        cluster = *next;
+        run->count++;
+    }
+}
+
+static fat32_chain_t* get_chain(fat32_volume_t* vol, uint32_t first_cluster) {
+    fat32_chain_t* victim = &vol->chains[0];
+
+    for (int i = 0; i < FAT32_RUN_CACHE_FILES; i++) {
+        fat32_chain_t* chain = &vol->chains[i];
+        if (chain->first_cluster == first_cluster) {
+            chain->last_used = ++vol->chain_clock;
+            vol->chain_hits++;
+            return chain;
+        }
+        if (chain->last_used < victim->last_used) {
+            victim = chain;
+        }
+    }
+
+    vol->chain_misses++;
+    victim->first_cluster = 0;
+    victim->num_runs = 0;
+    victim->complete = false;
+
+    fat_window_t window;
+    window.sector = FAT_WINDOW_EMPTY;
+    uint32_t cluster = first_cluster;
+    uint32_t total = 0;
+
+    while (victim->num_runs < FAT32_MAX_RUNS) {
+        fat32_run_t* run = &victim->runs[victim->num_runs];
+        uint32_t next;
+        if (walk_run(vol, &window, cluster, run, &next) != 0) {
+            return NULL;
+        }
+        victim->num_runs++;
+        total += run->count;
+
+        if (next >= FAT32_EOC || !cluster_valid(vol, next) || total >= vol->cluster_count) {
+            victim->complete = true;
+            break;
+        }
+        cluster = next;
+    }
+
+    victim->first_cluster = first_cluster;
+    victim->last_used = ++vol->chain_clock;
+    return victim;
+}
+
+// Iterates a chain run by run, walking the FAT past the cached runs of
+// files too fragmented to fit
+typedef struct {
+    fat32_volume_t* vol;
+    fat32_chain_t* chain;
+    uint32_t index;
+    fat32_run_t last;
+    fat_window_t window;
+} run_iter_t;
+
+static int run_iter_init(run_iter_t* it, fat32_volume_t* vol, uint32_t first_cluster) {
+    it->vol = vol;
+    it->chain = get_chain(vol, first_cluster);
+    it->index = 0;
+    it->window.sector = FAT_WINDOW_EMPTY;
+    return it->chain ? 0 : -1;
+}
+
+static bool run_iter_next(run_iter_t* it, fat32_run_t* run) {
+    if (it->index < it->chain->num_runs) {
+        *run = it->chain->runs[it->index++];
+        it->last = *run;
+        return true;
+    }
+    if (it->chain->complete) {
+        return false;
+    }
+
+    uint32_t next;
+    if (fat_next(it->vol, &it->window, it->last.cluster + it->last.count - 1, &next) != 0 ||
+        next >= FAT32_EOC || !cluster_valid(it->vol, next) ||
+        walk_run(it->vol, &it->window, next, run, &next) != 0) {
+        return false;
+    }
+    it->last = *run;
+    return true;
+}
+
+// Read bytes starting skip bytes into sector lba. Whole sectors go straight
+// to the destination in requests of up to FAT32_MAX_TRANSFER sectors.
+static int read_bytes(fat32_volume_t* vol, uint32_t lba, uint32_t skip, uint8_t* dst, uint32_t length) {
+    uint8_t sector[SECTOR_SIZE];
+
+    while (length > 0) {
+        if (skip != 0 || length < SECTOR_SIZE) {
+            if (blockdev_read(vol->dev, lba, 1, sector) != 0) {
+                return -1;
+            }
+            uint32_t n = SECTOR_SIZE - skip;
+            if (n > length) n = length;
+            memcpy(dst, sector + skip, n);
+            vol->data_requests++;
+            lba++;
+            skip = 0;
+            dst += n;
+            length -= n;
+            continue;
+        }
+
+        uint32_t sectors = length / SECTOR_SIZE;
+        if (sectors > FAT32_MAX_TRANSFER) sectors = FAT32_MAX_TRANSFER;
+        if (blockdev_read(vol->dev, lba, sectors, dst) != 0) {
+            return -1;
+        }
+        vol->data_requests++;
+        lba += sectors;
+        dst += sectors * SECTOR_SIZE;
+        length -= sectors * SECTOR_SIZE;
+    }
+    return 0;
+}
+
+static uint8_t short_name_checksum(const uint8_t* name) {
+    uint8_t sum = 0;
+    for (int i = 0; i < 11; i++) {
+        sum = ((sum & 1) << 7) + (sum >> 1) + name[i];
+    }
+    return sum;
+}
+
+static void decode_short_name(const uint8_t* e, char* name) {
+    int len = 0;
+    bool lower_base = e[12] & 0x08;
+    bool lower_ext = e[12] & 0x10;
+
+    for (int i = 0; i < 8 && e[i] != ' '; i++) {
+        name[len++] = lower_base ? to_lower(e[i]) : e[i];
+    }
+    if (e[8] != ' ') {
+        name[len++] = '.';
+        for (int i = 8; i < 11 && e[i] != ' '; i++) {
+            name[len++] = lower_ext ? to_lower(e[i]) : e[i];
+        }
+    }
+    name[len] = '\0';
+}
+
+// Long name entries hold 13 UCS-2 characters each; non-ASCII becomes '?'
+static void decode_lfn_part(const uint8_t* e, char* lfn) {
+    static const uint8_t offsets[13] = { 1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30 };
+    int sequence = e[0] & 0x1F;
+    if (sequence == 0) {
+        return;
+    }
+    int base = (sequence - 1) * 13;
+
+    for (int i = 0; i < 13 && base + i < FAT32_MAX_NAME - 1; i++) {
+        uint16_t c = read16(e + offsets[i]);
+        if (c == 0x0000) {
+            lfn[base + i] = '\0';
+            return;
+        }
+        if (c != 0xFFFF) {
+            lfn[base + i] = c < 0x80 ? (char)c : '?';
+        }
+    }
+}
+
+typedef int (*dir_callback_t)(const fat32_dirent_t* entry, void* ctx);
+
+// Call fn for each entry of a directory until it returns nonzero
+static int dir_iterate(fat32_volume_t* vol, uint32_t cluster, dir_callback_t fn, void* ctx) {
+    uint8_t sector[SECTOR_SIZE];
+    char lfn[FAT32_MAX_NAME];
+    uint8_t lfn_checksum = 0;
+    bool lfn_valid = false;
+
+    run_iter_t it;
+    if (run_iter_init(&it, vol, cluster) != 0) {
+        return -1;
+    }
+
+    fat32_run_t run;
+    while (run_iter_next(&it, &run)) {
+        uint32_t lba = cluster_to_sector(vol, run.cluster);
+        uint32_t sectors = run.count * vol->sectors_per_cluster;
+
+        for (uint32_t s = 0; s < sectors; s++) {
+            if (bcache_read(vol->dev, lba + s, 0, sector, SECTOR_SIZE) != 0) {
+                return -1;
+            }
+
+            for (int i = 0; i < ENTRIES_PER_SECTOR; i++) {
+                const uint8_t* e = sector + i * 32;
+                uint8_t attr = e[11];
+
+                if (e[0] == 0x00) {
+                    return 0; // End of directory
+                }
+                if (e[0] == 0xE5) {
+                    lfn_valid = false;
+                    continue;
+                }
+                if (attr == FAT32_ATTR_LFN) {
+                    if (e[0] & 0x40) {
+                        memset(lfn, 0, sizeof(lfn));
+                        lfn_checksum = e[13];
+                        lfn_valid = true;
+                    }
+                    if (lfn_valid && e[13] == lfn_checksum) {
+                        decode_lfn_part(e, lfn);
+                    } else {
+                        lfn_valid = false;
+                    }
+                    continue;
+                }
+                if (attr & FAT32_ATTR_VOLUME_ID) {
+                    lfn_valid = false;
+                    continue;
+                }
+
+                fat32_dirent_t entry;
+                if (lfn_valid && short_name_checksum(e) == lfn_checksum && lfn[0] != '\0') {
+                    strncpy(entry.name, lfn, FAT32_MAX_NAME - 1);
+                    entry.name[FAT32_MAX_NAME - 1] = '\0';
+                } else {
+                    decode_short_name(e, entry.name);
+                }
+                lfn_valid = false;
+
+                if (strcmp(entry.name, ".") == 0 || strcmp(entry.name, "..") == 0) {
+                    continue;
+                }
+
+                entry.attr = attr;
+                entry.first_cluster = ((uint32_t)read16(e + 20) << 16) | read16(e + 26);
+                entry.size = read32(e + 28);
+                if (fn(&entry, ctx)) {
+                    return 0;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+typedef struct {
+    const char* name;
+    fat32_dirent_t* result;
+    bool found;
+} find_ctx_t;
+
+static int find_callback(const fat32_dirent_t* entry, void* ctx) {
+    find_ctx_t* find = (find_ctx_t*)ctx;
+    if (name_equal(entry->name, find->name)) {
+        *find->result = *entry;
+        find->found = true;
+        return 1;
+    }
+    return 0;
+}
+
+int fat32_stat(fat32_volume_t* vol, const char* path, fat32_dirent_t* entry) {
+    // Start at the root, which has no entry of its own
+    strcpy(entry->name, "/");
+    entry->attr = FAT32_ATTR_DIRECTORY;
+    entry->first_cluster = vol->root_cluster;
+    entry->size = 0;
+
+    // Split by hand: callers may be in the middle of their own strtok loop
+    while (*path) {
+        while (*path == '/') path++;
+        if (*path == '\0') break;
+
+        char component[FAT32_MAX_NAME];
+        size_t len = 0;
+        while (path[len] && path[len] != '/') len++;
+        if (len >= sizeof(component)) {
+            return -1;
+        }
+        memcpy(component, path, len);
+        component[len] = '\0';
+        path += len;
+
+        if (!(entry->attr & FAT32_ATTR_DIRECTORY)) {
+            return -2; // Not a directory
+        }
+
+        fat32_dirent_t found;
+        find_ctx_t ctx = { component, &found, false };
+        if (dir_iterate(vol, entry->first_cluster, find_callback, &ctx) != 0) {
+            return -3; // I/O error
+        }
+        if (!ctx.found) {
+            return -1; // No such file or directory
+        }
+        *entry = found;
+    }
+    return 0;
+}
+
+typedef struct {
+    char* buffer;
+    size_t size;
+    size_t offset;
+} list_ctx_t;
+
+static int list_callback(const fat32_dirent_t* entry, void* ctx) {
+    list_ctx_t* list = (list_ctx_t*)ctx;
+    size_t len = strlen(entry->name);
+
+    if (entry->attr & (FAT32_ATTR_HIDDEN | FAT32_ATTR_SYSTEM)) {
+        return 0;
+    }
+    if (list->offset + len + 2 > list->size) {
+        return 1; // Buffer full
+    }
+
+    strcpy(list->buffer + list->offset, entry->name);
+    list->offset += len;
+    if (entry->attr & FAT32_ATTR_DIRECTORY) {
+        list->buffer[list->offset++] = '/';
+    }
+    list->buffer[list->offset++] = '\n';
+    return 0;
+}
+
+int fat32_list_directory(fat32_volume_t* vol, const char* path, char* buffer, size_t buffer_size) {
+    fat32_dirent_t dir;
+    if (fat32_stat(vol, path, &dir) != 0 || !(dir.attr & FAT32_ATTR_DIRECTORY)) {
+        return -1;
+    }
+
+    list_ctx_t ctx = { buffer, buffer_size, 0 };
+    if (dir_iterate(vol, dir.first_cluster, list_callback, &ctx) != 0) {
+        return -3;
+    }
+
+    // Same format as fs_list_directory: one name per line, no trailing newline
+    if (ctx.offset > 0) {
+        buffer[ctx.offset - 1] = '\0';
+    } else {
+        buffer[0] = '\0';
+    }
+    return ctx.offset;
+}
+
+int fat32_read(fat32_volume_t* vol, const char* path, uint32_t offset, void* buffer, size_t size) {
+    fat32_dirent_t file;
+    int result = fat32_stat(vol, path, &file);
+    if (result != 0) {
+        return result;
+    }
+    if (file.attr & FAT32_ATTR_DIRECTORY) {
+        return -4; // Cannot read a directory as a file
+    }
+    if (offset >= file.size || !cluster_valid(vol, file.first_cluster)) {
+        return 0;
+    }
+    if (size > file.size - offset) {
+        size = file.size - offset;
+    }
+
+    run_iter_t it;
+    if (run_iter_init(&it, vol, file.first_cluster) != 0) {
+        return -3;
+    }
+
+    // Each run is one contiguous extent on disk, read with as few
+    // requests as the transfer limit allows
+    uint32_t cluster_bytes = vol->sectors_per_cluster * SECTOR_SIZE;
+    uint32_t run_pos = 0;
+    uint32_t done = 0;
+    fat32_run_t run;
+
+    while (done < size && run_iter_next(&it, &run)) {
+        uint32_t run_bytes = run.count * cluster_bytes;
+        uint32_t want = offset + done;
+
+        if (want < run_pos + run_bytes) {
+            uint32_t within = want - run_pos;
+            uint32_t length = run_pos + run_bytes - want;
+            if (length > size - done) length = size - done;
+
+            uint32_t lba = cluster_to_sector(vol, run.cluster) + within / SECTOR_SIZE;
+            if (read_bytes(vol, lba, within % SECTOR_SIZE, (uint8_t*)buffer + done, length) != 0) {
+                return -3;
+            }
+            done += length;
+        }
+        run_pos += run_bytes;
+    }
+    return done;
+}
+
+static bool parse_boot_sector(fat32_volume_t* vol, const uint8_t* bs, uint32_t part_start) {
+    if (bs[510] != 0x55 || bs[511] != 0xAA || read16(bs + 11) != SECTOR_SIZE) {
+        return false;
+    }
+
+    uint32_t sectors_per_cluster = bs[13];
+    uint32_t reserved = read16(bs + 14);
+    uint32_t num_fats = bs[16];
+    uint32_t fat_size = read32(bs + 36);
+    uint32_t total = read32(bs + 32);
+
+    // FAT32 keeps the 16-bit FAT size at zero
+    if (sectors_per_cluster == 0 || num_fats == 0 || read16(bs + 22) != 0 || fat_size == 0 || total == 0) {
+        return false;
+    }
+
+    vol->part_start = part_start;
+    vol->sectors_per_cluster = sectors_per_cluster;
+    vol->fat_start = part_start + reserved;
+    vol->data_start = vol->fat_start + num_fats * fat_size;
+    vol->root_cluster = read32(bs + 44);
+
+    uint32_t data_sectors = total - (vol->data_start - part_start);
+    vol->cluster_count = data_sectors / sectors_per_cluster;
+    if (vol->cluster_count > fat_size * (SECTOR_SIZE / 4) - 2) {
+        vol->cluster_count = fat_size * (SECTOR_SIZE / 4) - 2;
+    }
+
+    memcpy(vol->label, bs + 71, 11);
+    vol->label[11] = '\0';
+    for (int i = 10; i >= 0 && vol->label[i] == ' '; i--) {
+        vol->label[i] = '\0';
+    }
+    return cluster_valid(vol, vol->root_cluster);
+}
+
+fat32_volume_t* fat32_mount(block_device_t* dev) {
+    for (int i = 0; i < num_volumes; i++) {
+        if (volumes[i].dev == dev) {
+            return &volumes[i];
+        }
+    }
+    if (num_volumes >= FAT32_MAX_VOLUMES) {
+        return NULL;
+    }
+
+    fat32_volume_t* vol = &volumes[num_volumes];
+    memset(vol, 0, sizeof(fat32_volume_t));
+    vol->dev = dev;
+
+    uint8_t sector[SECTOR_SIZE];
+    if (blockdev_read(dev, 0, 1, sector) != 0) {
+        return NULL;
+    }
+
+    if (!parse_boot_sector(vol, sector, 0)) {
+        // Partitioned disk: use the first FAT32 partition of the MBR
+        bool found = false;
+        for (int p = 0; p < 4 && !found; p++) {
+            const uint8_t* entry = sector + 446 + p * 16;
+            uint8_t type = entry[4];
+            uint32_t start = read32(entry + 8);
+            uint8_t boot[SECTOR_SIZE];
+
+            if ((type == 0x0B || type == 0x0C) && start != 0 &&
+                blockdev_read(dev, start, 1, boot) == 0 && parse_boot_sector(vol, boot, start)) {
+                found = true;
+            }
+        }
+        if (!found) {
+            return NULL; // Not a FAT32 volume
+        }
+    }
+
+    num_volumes++;
+    return vol;
+}
+
+// VFS backend: mounted volumes are read-only
+
+static int fat32_vfs_stat(vfs_mount_t* mnt, const char* path, vfs_stat_t* st) {
+    fat32_dirent_t entry;
+    int result = fat32_stat((fat32_volume_t*)mnt->data, path, &entry);
+    if (result != 0) {
+        return result == -3 ? VFS_EIO : VFS_ENOENT;
+    }
+    st->size = entry.size;
+    st->stored_size = entry.size;
+    st->is_directory = (entry.attr & FAT32_ATTR_DIRECTORY) != 0;
+    st->permissions = st->is_directory ? 0555 : 0444;
+    st->modified_time = 0;
+    return 0;
+}
+
+static int fat32_vfs_read(vfs_mount_t* mnt, const char* path, uint32_t offset, void* buffer, size_t size) {
+    int result = fat32_read((fat32_volume_t*)mnt->data, path, offset, buffer, size);
+    if (result >= 0) {
+        return result;
+    }
+    return result == -3 ? VFS_EIO : result == -4 ? VFS_EISDIR : VFS_ENOENT;
+}
+
+static int fat32_vfs_list(vfs_mount_t* mnt, const char* path, char* buffer, size_t size) {
+    int result = fat32_list_directory((fat32_volume_t*)mnt->data, path, buffer, size);
+    if (result >= 0) {
+        return result;
+    }
+    return result == -3 ? VFS_EIO : VFS_ENOENT;
+}
+
+const vfs_ops_t fat32_vfs_ops = {
+    .name = "fat32",
+    .stat = fat32_vfs_stat,
+    .read = fat32_vfs_read,
+    .list = fat32_vfs_list,
+};
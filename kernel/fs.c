@@ -1,22 +1,177 @@
 #include "../include/kernel/fs.h"
+#include "../include/kernel/fs_disk.h"
+#include "../include/kernel/journal.h"
+#include "../include/kernel/lz.h"
 #include "../include/kernel/system.h"
 #include "../include/libc/string.h"
 #include "../include/libc/stdio.h"
 
-static filesystem_t filesystem;
+// Boot-time storage; fs_load_image() can point the instance at a prebuilt image
+static filesystem_t filesystem_storage;
+static filesystem_t* filesystem = &filesystem_storage;
 static uint32_t system_time = 0;
+static fs_counters_t counters;
+
+// Staging for compressed data and for partial blocks
+static uint8_t compress_buffer[FS_MAX_FILE_SIZE];
+static uint8_t block_buffer[FS_COMPRESS_BLOCK];
+
+// Journal record types. Records are physical redo: replaying one twice
+// leaves the same state, so a partially checkpointed log is harmless.
+#define FS_JOURNAL_ENTRY 1   // fs_journal_entry_t
+#define FS_JOURNAL_DATA  2   // fs_journal_data_t followed by the bytes
+
+typedef struct {
+    uint32_t index;          // Entry slot; ignored if not below num_entries
+    uint32_t num_entries;
+    uint32_t data_used;
+    fs_entry_t entry;
+} fs_journal_entry_t;
+
+typedef struct {
+    uint32_t offset;         // Offset into the data area
+    uint32_t data_used;
+} fs_journal_data_t;
+
+// Snapshots: a frozen copy of an instance's entry table. The snapshot
+// holds a reference to every block its files map, so those blocks stay
+// put and later writes to the live files copy them first.
+typedef struct {
+    filesystem_t* instance;  // NULL while the slot is free
+    uint32_t created_time;
+    uint32_t num_entries;
+    fs_entry_t entries[FS_MAX_FILES];
+} fs_snapshot_t;
+
+static fs_snapshot_t snapshots[FS_MAX_SNAPSHOTS];
+
+// Instance the compactor found fully laid out; any change to a block
+// mapping clears it
+static filesystem_t* compacted = NULL;
+
+static bool journaling = false;
+
+// The instance the journal and disk belong to; other instances (such as
+// the /tmp ramfs) are never logged or written back
+static filesystem_t* backed_instance = NULL;
+
+static bool is_backed(void) {
+    return journaling && filesystem == backed_instance;
+}
+
+static void index_block(uint16_t block);
+static void rebuild_blocks(void);
+static void rebuild_index(void);
+
+static int data_fault_in(uint32_t offset, uint32_t size) {
+    if (filesystem != backed_instance || fs_disk_is_resident(offset, size)) {
+        return 0;
+    }
+    if (fs_disk_fault_in(offset, size) != 0) {
+        return -1;
+    }
+    
+    // Blocks loaded from disk can be shared from now on
+    for (uint32_t b = offset / FS_BLOCK_SIZE; b <= (offset + size - 1) / FS_BLOCK_SIZE; b++) {
+        if (filesystem->block_refs[b] && !filesystem->block_hash[b]) {
+            index_block(b);
+        }
+    }
+    return 0;
+}
+
+static int data_write_prepare(uint32_t offset, uint32_t size) {
+    return filesystem == backed_instance ? fs_disk_write_prepare(offset, size) : 0;
+}
 
 // Simple time function
 static uint32_t get_time(void) {
     return ++system_time;
 }
 
-void fs_init(void) {
-    memset(&filesystem, 0, sizeof(filesystem_t));
-    strcpy(filesystem.current_path, "/");
+// Log the current contents of an entry slot along with the table counters
+static void log_entry(uint32_t index) {
+    if (!is_backed()) {
+        return;
+    }
+    
+    fs_journal_entry_t* rec = journal_reserve(FS_JOURNAL_ENTRY, sizeof(fs_journal_entry_t));
+    if (!rec) {
+        return; // Transaction full: fs_commit() checkpoints instead
+    }
+    rec->index = index;
+    rec->num_entries = filesystem->num_entries;
+    rec->data_used = filesystem->data_used;
+    if (index < filesystem->num_entries) {
+        rec->entry = filesystem->entries[index];
+    } else {
+        memset(&rec->entry, 0, sizeof(fs_entry_t));
+    }
+}
+
+// Log only the bytes a write changed, not the whole data area
+static void log_data(uint32_t offset, uint32_t size) {
+    if (!is_backed()) {
+        return;
+    }
+    
+    fs_journal_data_t* rec = journal_reserve(FS_JOURNAL_DATA, sizeof(fs_journal_data_t) + size);
+    if (!rec) {
+        return; // Transaction full: fs_commit() checkpoints instead
+    }
+    rec->offset = offset;
+    rec->data_used = filesystem->data_used;
+    memcpy(rec + 1, filesystem->data + offset, size);
+}
+
+static int fs_apply_record(uint16_t type, const void* payload, uint32_t length) {
+    if (type == FS_JOURNAL_ENTRY) {
+        const fs_journal_entry_t* rec = (const fs_journal_entry_t*)payload;
+        if (length < sizeof(fs_journal_entry_t) || rec->num_entries > FS_MAX_FILES) {
+            return -1;
+        }
+        if (rec->index < rec->num_entries) {
+            filesystem->entries[rec->index] = rec->entry;
+        }
+        filesystem->num_entries = rec->num_entries;
+        filesystem->data_used = rec->data_used;
+        return 0;
+    }
+    
+    if (type == FS_JOURNAL_DATA) {
+        const fs_journal_data_t* rec = (const fs_journal_data_t*)payload;
+        if (length < sizeof(fs_journal_data_t)) {
+            return -1;
+        }
+        uint32_t size = length - sizeof(fs_journal_data_t);
+        if (rec->offset > FS_TOTAL_DATA_SIZE || size > FS_TOTAL_DATA_SIZE - rec->offset) {
+            return -1;
+        }
+        if (data_write_prepare(rec->offset, size) != 0) {
+            return -1;
+        }
+        memcpy(filesystem->data + rec->offset, rec + 1, size);
+        filesystem->data_used = rec->data_used;
+        return 0;
+    }
+    
+    return -1; // Unknown record type
+}
+
+void fs_format(void) {
+    // The data area is left alone: nothing refers to it once the table is empty
+    memset(filesystem->entries, 0, sizeof(filesystem->entries));
+    filesystem->num_entries = 0;
+    strcpy(filesystem->current_path, "/");
+    rebuild_blocks();
+    rebuild_index();
     
     // Create root directory
     fs_create_file("/", 1);
+}
+
+void fs_init(void) {
+    fs_format();
     
     // Create initial directories with Linux-like structure
     fs_create_file("/bin", 1);
@@ -155,8 +310,332 @@ void fs_get_directory(const char* path, char* directory, size_t size) {
     }
 }
 
-int fs_create_file(const char* filename, uint8_t is_directory) {
-    if (filesystem.num_entries >= FS_MAX_FILES) {
+static uint32_t block_count(uint32_t stored) {
+    return (stored + FS_BLOCK_SIZE - 1) / FS_BLOCK_SIZE;
+}
+
+static uint32_t hash_contents(const uint8_t* data) {
+    // FNV-1a over 32-bit words; 0 is kept free to mean "not indexed"
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < FS_BLOCK_SIZE; i += 4) {
+        uint32_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 16777619u;
+    }
+    return hash ? hash : 1;
+}
+
+static void index_block(uint16_t block) {
+    uint32_t hash = hash_contents(filesystem->data + block * FS_BLOCK_SIZE);
+    uint16_t* bucket = &filesystem->hash_buckets[hash % FS_HASH_BUCKETS];
+    filesystem->block_hash[block] = hash;
+    filesystem->hash_next[block] = *bucket;
+    *bucket = block;
+}
+
+static void unindex_block(uint16_t block) {
+    uint32_t hash = filesystem->block_hash[block];
+    if (!hash) {
+        return;
+    }
+    uint16_t* link = &filesystem->hash_buckets[hash % FS_HASH_BUCKETS];
+    while (*link != block) {
+        link = &filesystem->hash_next[*link];
+    }
+    *link = filesystem->hash_next[block];
+    filesystem->block_hash[block] = 0;
+}
+
+// An indexed block holding exactly these bytes, or FS_NO_BLOCK
+static uint16_t find_block(uint32_t hash, const uint8_t* data) {
+    uint16_t b = filesystem->hash_buckets[hash % FS_HASH_BUCKETS];
+    while (b != FS_NO_BLOCK) {
+        if (filesystem->block_hash[b] == hash &&
+            memcmp(filesystem->data + b * FS_BLOCK_SIZE, data, FS_BLOCK_SIZE) == 0) {
+            return b;
+        }
+        b = filesystem->hash_next[b];
+    }
+    return FS_NO_BLOCK;
+}
+
+static void ref_block(uint16_t block) {
+    if (filesystem->block_refs[block]++ == 0) {
+        filesystem->data_used += FS_BLOCK_SIZE;
+    }
+    compacted = NULL;
+}
+
+static void unref_block(uint16_t block) {
+    if (--filesystem->block_refs[block] == 0) {
+        filesystem->data_used -= FS_BLOCK_SIZE;
+    }
+    compacted = NULL;
+}
+
+// Next free block after the last one handed out
+static uint16_t alloc_block(void) {
+    for (uint32_t i = 0; i < FS_NUM_BLOCKS; i++) {
+        uint32_t b = (filesystem->next_block + i) % FS_NUM_BLOCKS;
+        if (filesystem->block_refs[b] == 0) {
+            filesystem->next_block = b + 1;
+            return b;
+        }
+    }
+    return FS_NO_BLOCK;
+}
+
+// Drop unreferenced blocks from the index so they are never shared again
+static void forget_blocks(const uint16_t* blocks, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (filesystem->block_refs[blocks[i]] == 0) {
+            unindex_block(blocks[i]);
+        }
+    }
+}
+
+static void ref_entries(const fs_entry_t* entries, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (!entries[i].is_directory) {
+            for (uint32_t k = 0; k < block_count(fs_entry_stored_size(&entries[i])); k++) {
+                ref_block(entries[i].blocks[k]);
+            }
+        }
+    }
+}
+
+static void unref_entries(const fs_entry_t* entries, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (!entries[i].is_directory) {
+            uint32_t blocks = block_count(fs_entry_stored_size(&entries[i]));
+            for (uint32_t k = 0; k < blocks; k++) {
+                unref_block(entries[i].blocks[k]);
+            }
+            forget_blocks(entries[i].blocks, blocks);
+        }
+    }
+}
+
+// Recompute the reference counts and the index from the entry table
+static void rebuild_blocks(void) {
+    memset(filesystem->block_refs, 0, sizeof(filesystem->block_refs));
+    memset(filesystem->block_hash, 0, sizeof(filesystem->block_hash));
+    memset(filesystem->hash_buckets, 0xFF, sizeof(filesystem->hash_buckets));
+    filesystem->data_used = 0;
+    filesystem->next_block = 0;
+    
+    ref_entries(filesystem->entries, filesystem->num_entries);
+    for (uint32_t i = 0; i < FS_MAX_SNAPSHOTS; i++) {
+        if (snapshots[i].instance == filesystem) {
+            ref_entries(snapshots[i].entries, snapshots[i].num_entries);
+        }
+    }
+    
+    // Blocks still on disk are indexed when they are faulted in
+    for (uint32_t b = 0; b < FS_NUM_BLOCKS; b++) {
+        if (filesystem->block_refs[b] &&
+            (filesystem != backed_instance || fs_disk_is_resident(b * FS_BLOCK_SIZE, FS_BLOCK_SIZE))) {
+            index_block(b);
+        }
+    }
+}
+
+// Store an entry's new contents. Each block either points at an existing
+// block with the same bytes, reuses the entry's own block at that position
+// if nothing else maps it, or is written to a free block - a block other
+// files still map is never modified, so sharers keep their contents.
+static int store_blocks(fs_entry_t* entry, uint32_t old_count, const uint8_t* contents, uint32_t size) {
+    uint16_t old_blocks[FS_MAX_FILE_BLOCKS];
+    uint32_t count = block_count(size);
+    
+    memcpy(old_blocks, entry->blocks, old_count * sizeof(uint16_t));
+    for (uint32_t i = 0; i < old_count; i++) {
+        unref_block(old_blocks[i]);
+    }
+    if (FS_TOTAL_DATA_SIZE - filesystem->data_used < count * FS_BLOCK_SIZE) {
+        for (uint32_t i = 0; i < old_count; i++) {
+            ref_block(old_blocks[i]);
+        }
+        return -1;
+    }
+    
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t length = size - i * FS_BLOCK_SIZE < FS_BLOCK_SIZE ? size - i * FS_BLOCK_SIZE : FS_BLOCK_SIZE;
+        memcpy(block_buffer, contents + i * FS_BLOCK_SIZE, length);
+        memset(block_buffer + length, 0, FS_BLOCK_SIZE - length);
+        
+        uint32_t hash = hash_contents(block_buffer);
+        uint16_t block = find_block(hash, block_buffer);
+        if (block == FS_NO_BLOCK) {
+            block = (i < old_count && filesystem->block_refs[old_blocks[i]] == 0) ? old_blocks[i] : alloc_block();
+            
+            // Whole sectors are overwritten without being read first, so
+            // preparing them cannot fail
+            data_write_prepare(block * FS_BLOCK_SIZE, FS_BLOCK_SIZE);
+            unindex_block(block);
+            memcpy(filesystem->data + block * FS_BLOCK_SIZE, block_buffer, FS_BLOCK_SIZE);
+            index_block(block);
+            log_data(block * FS_BLOCK_SIZE, FS_BLOCK_SIZE);
+        }
+        ref_block(block);
+        entry->blocks[i] = block;
+    }
+    
+    forget_blocks(old_blocks, old_count);
+    return 0;
+}
+
+// Copy stored bytes out of an entry's blocks
+static int read_stored(const fs_entry_t* entry, uint32_t offset, uint8_t* buffer, uint32_t size) {
+    uint32_t done = 0;
+    while (done < size) {
+        uint32_t pos = offset + done;
+        uint32_t within = pos % FS_BLOCK_SIZE;
+        uint32_t count = FS_BLOCK_SIZE - within < size - done ? FS_BLOCK_SIZE - within : size - done;
+        uint32_t at = entry->blocks[pos / FS_BLOCK_SIZE] * FS_BLOCK_SIZE + within;
+        
+        if (data_fault_in(at, count) != 0) {
+            return -1;
+        }
+        memcpy(buffer + done, filesystem->data + at, count);
+        done += count;
+    }
+    return done;
+}
+
+// Path order: like strcmp, but '/' sorts before every other character, so
+// a directory is followed directly by everything beneath it (depth first)
+static int path_compare(const char* a, const char* b) {
+    const uint8_t* x = (const uint8_t*)a;
+    const uint8_t* y = (const uint8_t*)b;
+    while (*x && *x == *y) {
+        x++;
+        y++;
+    }
+    int cx = *x == '/' ? 1 : (*x && *x < '/' ? *x + 1 : *x);
+    int cy = *y == '/' ? 1 : (*y && *y < '/' ? *y + 1 : *y);
+    return cx - cy;
+}
+
+// First position in the path index whose name sorts at or after name
+static uint32_t lower_bound(const char* name) {
+    uint32_t low = 0;
+    uint32_t high = filesystem->num_entries;
+    while (low < high) {
+        uint32_t mid = (low + high) / 2;
+        if (path_compare(filesystem->entries[filesystem->sorted[mid]].filename, name) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// Entry index of an exact path, or -1
+static int find_entry(const char* filename) {
+    uint32_t pos = lower_bound(filename);
+    if (pos < filesystem->num_entries &&
+        strcmp(filesystem->entries[filesystem->sorted[pos]].filename, filename) == 0) {
+        return filesystem->sorted[pos];
+    }
+    return -1;
+}
+
+// Add the entry in slot index, already named, to the path index
+static void index_entry(uint32_t index) {
+    uint32_t pos = lower_bound(filesystem->entries[index].filename);
+    memmove(&filesystem->sorted[pos + 1], &filesystem->sorted[pos],
+            (index - pos) * sizeof(uint16_t));
+    filesystem->sorted[pos] = index;
+}
+
+static void rebuild_index(void) {
+    uint32_t count = filesystem->num_entries;
+    for (uint32_t i = 0; i < count; i++) {
+        filesystem->num_entries = i; // Search only the part sorted so far
+        index_entry(i);
+    }
+    filesystem->num_entries = count;
+}
+
+// New entries take the compression setting of their directory
+static uint8_t inherited_flags(const char* filename) {
+    char parent[FS_MAX_FILENAME_LENGTH];
+    fs_get_directory(filename, parent, sizeof(parent));
+    const fs_entry_t* dir = fs_lookup(parent);
+    return dir ? (dir->flags & FS_FLAG_COMPRESS) : 0;
+}
+
+// Compress a file into compress_buffer: a table of 16-bit block end
+// offsets, then the blocks. Returns the stored size, or -1 when
+// compression would not save space.
+static int compress_contents(const uint8_t* data, uint32_t size) {
+    uint32_t num_blocks = (size + FS_COMPRESS_BLOCK - 1) / FS_COMPRESS_BLOCK;
+    uint32_t table_size = num_blocks * sizeof(uint16_t);
+    uint32_t pos = table_size;
+    
+    if (size == 0 || table_size >= size) {
+        return -1;
+    }
+    for (uint32_t b = 0; b < num_blocks; b++) {
+        uint32_t start = b * FS_COMPRESS_BLOCK;
+        uint32_t length = size - start < FS_COMPRESS_BLOCK ? size - start : FS_COMPRESS_BLOCK;
+        int n = lz_compress(data + start, length, compress_buffer + pos, size - 1 - pos);
+        if (n < 0) {
+            return -1;
+        }
+        pos += n;
+        uint16_t end = pos - table_size;
+        memcpy(compress_buffer + b * sizeof(uint16_t), &end, sizeof(end));
+    }
+    return pos;
+}
+
+// Read from a compressed file, decompressing only the blocks the range
+// touches. Whole blocks go straight into the caller's buffer.
+static int read_compressed(const fs_entry_t* entry, uint32_t offset, uint8_t* buffer, uint32_t size) {
+    uint32_t num_blocks = (entry->size + FS_COMPRESS_BLOCK - 1) / FS_COMPRESS_BLOCK;
+    uint32_t table_size = num_blocks * sizeof(uint16_t);
+    uint16_t ends[FS_MAX_FILE_SIZE / FS_COMPRESS_BLOCK];
+    
+    if (num_blocks > sizeof(ends) / sizeof(ends[0]) ||
+        read_stored(entry, 0, (uint8_t*)ends, table_size) < 0) {
+        return -1;
+    }
+    
+    uint32_t done = 0;
+    for (uint32_t b = offset / FS_COMPRESS_BLOCK; done < size; b++) {
+        uint32_t start = b ? ends[b - 1] : 0;
+        uint32_t block_start = b * FS_COMPRESS_BLOCK;
+        uint32_t block_size = entry->size - block_start < FS_COMPRESS_BLOCK ? entry->size - block_start : FS_COMPRESS_BLOCK;
+        uint32_t within = offset + done - block_start;
+        uint32_t count = block_size - within < size - done ? block_size - within : size - done;
+        
+        // The compressed block may span data blocks; gather it first
+        if (ends[b] < start || table_size + ends[b] > entry->stored_size ||
+            read_stored(entry, table_size + start, compress_buffer, ends[b] - start) < 0) {
+            return -1;
+        }
+        const uint8_t* src = compress_buffer;
+        if (within == 0 && count == block_size) {
+            if (lz_decompress(src, ends[b] - start, buffer + done, block_size) != (int)block_size) {
+                return -1;
+            }
+        } else {
+            if (lz_decompress(src, ends[b] - start, block_buffer, block_size) != (int)block_size) {
+                return -1;
+            }
+            memcpy(buffer + done, block_buffer + within, count);
+        }
+        done += count;
+    }
+    return done;
+}
+
+// Add a table entry without logging it
+static int create_entry(const char* filename, uint8_t is_directory) {
+    if (filesystem->num_entries >= FS_MAX_FILES) {
         return -1; // No space for new files
     }
     
@@ -164,116 +643,162 @@ int fs_create_file(const char* filename, uint8_t is_directory) {
         return -2; // File already exists
     }
     
-    fs_entry_t* entry = &filesystem.entries[filesystem.num_entries];
+    fs_entry_t* entry = &filesystem->entries[filesystem->num_entries];
     strncpy(entry->filename, filename, FS_MAX_FILENAME_LENGTH - 1);
     entry->filename[FS_MAX_FILENAME_LENGTH - 1] = '\0';
     entry->size = 0;
-    entry->data_offset = filesystem.data_used;
     entry->is_directory = is_directory;
+    entry->flags = inherited_flags(filename);
+    entry->stored_size = 0;
     entry->created_time = get_time();
     entry->modified_time = entry->created_time;
     entry->permissions = 0755; // Default permissions
     entry->parent_index = 0; // Will be set properly later
     
-    filesystem.num_entries++;
+    index_entry(filesystem->num_entries);
+    filesystem->num_entries++;
+    counters.creates++;
     return 0;
 }
 
+int fs_create_file(const char* filename, uint8_t is_directory) {
+    int result = create_entry(filename, is_directory);
+    if (result == 0) {
+        log_entry(filesystem->num_entries - 1);
+    }
+    return result;
+}
+
 int fs_write_file(const char* filename, const void* data, size_t size) {
     if (size > FS_MAX_FILE_SIZE) {
         return -1; // File too large
     }
     
-    if (filesystem.data_used + size > FS_TOTAL_DATA_SIZE) {
-        return -2; // Not enough space
+    // Find existing file
+    int found = find_entry(filename);
+    fs_entry_t* entry = found >= 0 ? &filesystem->entries[found] : NULL;
+    uint32_t index = found >= 0 ? found : 0;
+    if (entry && entry->is_directory) {
+        return -3; // Cannot write to directory
     }
     
-    // Find existing file
-    for (uint32_t i = 0; i < filesystem.num_entries; i++) {
-        if (strcmp(filesystem.entries[i].filename, filename) == 0) {
-            if (filesystem.entries[i].is_directory) {
-                return -3; // Cannot write to directory
-            }
-            
-            // Update existing file
-            filesystem.entries[i].size = size;
-            filesystem.entries[i].modified_time = get_time();
-            memcpy(filesystem.data + filesystem.entries[i].data_offset, data, size);
-            return 0;
+    // Compressed contents are only kept if they are smaller
+    uint8_t flags = (entry ? entry->flags : inherited_flags(filename)) & ~FS_FLAG_COMPRESSED;
+    const void* contents = data;
+    uint32_t stored = size;
+    if (flags & FS_FLAG_COMPRESS) {
+        int n = compress_contents((const uint8_t*)data, size);
+        if (n >= 0) {
+            contents = compress_buffer;
+            stored = n;
+            flags |= FS_FLAG_COMPRESSED;
+        }
+    }
+    
+    uint32_t old_count = 0;
+    if (entry) {
+        old_count = block_count(fs_entry_stored_size(entry));
+    } else {
+        // File doesn't exist, create it
+        if (FS_TOTAL_DATA_SIZE - filesystem->data_used < block_count(stored) * FS_BLOCK_SIZE) {
+            return -2; // Not enough space
+        }
+        if (create_entry(filename, 0) != 0) {
+            return -4; // Failed to create file
         }
+        index = filesystem->num_entries - 1;
+        entry = &filesystem->entries[index];
     }
     
-    // File doesn't exist, create it
-    if (fs_create_file(filename, 0) != 0) {
-        return -4; // Failed to create file
+    if (store_blocks(entry, old_count, (const uint8_t*)contents, stored) != 0) {
+        return -2; // Not enough space
     }
     
-    fs_entry_t* entry = &filesystem.entries[filesystem.num_entries - 1];
     entry->size = size;
-    entry->data_offset = filesystem.data_used;
+    entry->flags = flags;
+    entry->stored_size = (flags & FS_FLAG_COMPRESSED) ? stored : 0;
     entry->modified_time = get_time();
-    memcpy(filesystem.data + entry->data_offset, data, size);
-    filesystem.data_used += size;
+    counters.writes++;
+    counters.bytes_written += size;
     
+    log_entry(index);
     return 0;
 }
 
 int fs_read_file(const char* filename, void* buffer, size_t buffer_size) {
-    for (uint32_t i = 0; i < filesystem.num_entries; i++) {
-        if (strcmp(filesystem.entries[i].filename, filename) == 0) {
-            if (filesystem.entries[i].is_directory) {
-                return -1; // Cannot read directory as file
-            }
-            
-            size_t size_to_copy = filesystem.entries[i].size;
-            if (size_to_copy > buffer_size) {
-                size_to_copy = buffer_size;
-            }
-            
-            memcpy(buffer, filesystem.data + filesystem.entries[i].data_offset, size_to_copy);
-            return size_to_copy;
-        }
+    return fs_read_at(filename, 0, buffer, buffer_size);
+}
+
+int fs_read_at(const char* filename, uint32_t offset, void* buffer, size_t buffer_size) {
+    int i = find_entry(filename);
+    if (i < 0) {
+        return -2; // File not found
+    }
+    
+    const fs_entry_t* entry = &filesystem->entries[i];
+    if (entry->is_directory) {
+        return -1; // Cannot read directory as file
+    }
+    
+    if (offset >= entry->size) {
+        return 0;
+    }
+    size_t size_to_copy = entry->size - offset;
+    if (size_to_copy > buffer_size) {
+        size_to_copy = buffer_size;
     }
     
-    return -2; // File not found
+    if (entry->flags & FS_FLAG_COMPRESSED) {
+        if (read_compressed(entry, offset, buffer, size_to_copy) < 0) {
+            return -3; // I/O error or corrupt data
+        }
+    } else {
+        if (read_stored(entry, offset, buffer, size_to_copy) < 0) {
+            return -3; // I/O error
+        }
+    }
+    counters.reads++;
+    counters.bytes_read += size_to_copy;
+    return size_to_copy;
 }
 
 int fs_delete_file(const char* filename) {
-    for (uint32_t i = 0; i < filesystem.num_entries; i++) {
-        if (strcmp(filesystem.entries[i].filename, filename) == 0) {
-            // Don't allow deletion of root directory
-            if (strcmp(filename, "/") == 0) {
-                return -2; // Cannot delete root
-            }
-            
-            // Simple deletion by swapping with the last entry
-            if (i < filesystem.num_entries - 1) {
-                filesystem.entries[i] = filesystem.entries[filesystem.num_entries - 1];
-            }
-            filesystem.num_entries--;
-            return 0;
-        }
+    int found = find_entry(filename);
+    if (found < 0) {
+        return -1; // File not found
+    }
+    
+    // Don't allow deletion of root directory
+    if (strcmp(filename, "/") == 0) {
+        return -2; // Cannot delete root
     }
     
-    return -1; // File not found
+    // Blocks no other file or snapshot maps become free
+    uint32_t i = found;
+    uint32_t last = filesystem->num_entries - 1;
+    unref_entries(&filesystem->entries[i], 1);
+    
+    // Drop the entry from the path index; the last slot moves into its
+    // place, so the index position naming it follows
+    uint32_t pos = lower_bound(filename);
+    memmove(&filesystem->sorted[pos], &filesystem->sorted[pos + 1], (last - pos) * sizeof(uint16_t));
+    filesystem->num_entries--;
+    if (i < last) {
+        filesystem->sorted[lower_bound(filesystem->entries[last].filename)] = i;
+        filesystem->entries[i] = filesystem->entries[last];
+    }
+    counters.deletes++;
+    log_entry(i);
+    return 0;
 }
 
 int fs_file_exists(const char* filename) {
-    for (uint32_t i = 0; i < filesystem.num_entries; i++) {
-        if (strcmp(filesystem.entries[i].filename, filename) == 0) {
-            return 1;
-        }
-    }
-    return 0;
+    return find_entry(filename) >= 0;
 }
 
 size_t fs_file_size(const char* filename) {
-    for (uint32_t i = 0; i < filesystem.num_entries; i++) {
-        if (strcmp(filesystem.entries[i].filename, filename) == 0) {
-            return filesystem.entries[i].size;
-        }
-    }
-    return 0;
+    int i = find_entry(filename);
+    return i >= 0 ? filesystem->entries[i].size : 0;
 }
 
 int fs_list_directory(const char* dirname, char* buffer, size_t buffer_size) {
@@ -293,38 +818,40 @@ int fs_list_directory(const char* dirname, char* buffer, size_t buffer_size) {
         }
     }
     
-    for (uint32_t i = 0; i < filesystem.num_entries; i++) {
-        const char* filename = filesystem.entries[i].filename;
+    // Everything under the directory is one run of the path index, so
+    // only that run is visited and names come out sorted
+    uint32_t first;
+    uint32_t count = fs_prefix_range(normalized_dirname, &first);
+    for (uint32_t p = first; p < first + count; p++) {
+        const fs_entry_t* entry = fs_entry_at(p);
+        const char* filename = entry->filename;
         
         // Skip the directory itself
         if (strcmp(filename, normalized_dirname) == 0) {
             continue;
         }
         
-        // Check if file is in the requested directory
-        if (strncmp(filename, normalized_dirname, dirname_len) == 0) {
-            const char* remaining = filename + dirname_len;
+        const char* remaining = filename + dirname_len;
+        
+        // Check if this is a direct child (no more '/' in remaining path)
+        if (strchr(remaining, '/') == NULL && strlen(remaining) > 0) {
+            size_t name_len = strlen(remaining);
             
-            // Check if this is a direct child (no more '/' in remaining path)
-            if (strchr(remaining, '/') == NULL && strlen(remaining) > 0) {
-                size_t name_len = strlen(remaining);
-                
-                // Check buffer space
-                if (offset + name_len + 2 > buffer_size) {
-                    break; // Buffer full
-                }
-                
-                // Copy filename
-                strcpy(buffer + offset, remaining);
-                offset += name_len;
-                
-                // Add directory indicator
-                if (filesystem.entries[i].is_directory) {
-                    buffer[offset++] = '/';
-                }
-                
-                buffer[offset++] = '\n';
+            // Check buffer space
+            if (offset + name_len + 2 > buffer_size) {
+                break; // Buffer full
             }
+            
+            // Copy filename
+            strcpy(buffer + offset, remaining);
+            offset += name_len;
+            
+            // Add directory indicator
+            if (entry->is_directory) {
+                buffer[offset++] = '/';
+            }
+            
+            buffer[offset++] = '\n';
         }
     }
     
@@ -374,41 +901,544 @@ int fs_change_directory(const char* dirname, char* current_dir, size_t dir_size)
 }
 
 void fs_get_stats(uint32_t* total_files, uint32_t* total_size, uint32_t* free_size) {
-    if (total_files) *total_files = filesystem.num_entries;
-    if (total_size) *total_size = filesystem.data_used;
-    if (free_size) *free_size = FS_TOTAL_DATA_SIZE - filesystem.data_used;
+    if (total_files) *total_files = filesystem->num_entries;
+    if (total_size) *total_size = filesystem->data_used;
+    if (free_size) *free_size = FS_TOTAL_DATA_SIZE - filesystem->data_used;
 }
 
-const char* fs_get_file_type_string(const char* filename) {
-    for (uint32_t i = 0; i < filesystem.num_entries; i++) {
-        if (strcmp(filesystem.entries[i].filename, filename) == 0) {
-            return filesystem.entries[i].is_directory ? "directory" : "file";
+void fs_get_counters(fs_counters_t* out) {
+    *out = counters;
+}
+
+void fs_get_dedup_stats(uint32_t* logical_size, uint32_t* physical_size) {
+    // Walk the live entries rather than block_refs, which also counts the
+    // references snapshots hold
+    uint8_t seen[FS_NUM_BLOCKS / 8];
+    uint32_t mapped = 0;
+    uint32_t distinct = 0;
+    memset(seen, 0, sizeof(seen));
+    
+    for (uint32_t i = 0; i < filesystem->num_entries; i++) {
+        const fs_entry_t* entry = &filesystem->entries[i];
+        if (entry->is_directory) {
+            continue;
         }
+        for (uint32_t k = 0; k < block_count(fs_entry_stored_size(entry)); k++) {
+            uint16_t block = entry->blocks[k];
+            mapped++;
+            if (!(seen[block / 8] & (1 << (block % 8)))) {
+                seen[block / 8] |= 1 << (block % 8);
+                distinct++;
+            }
+        }
+    }
+    if (logical_size) *logical_size = mapped * FS_BLOCK_SIZE;
+    if (physical_size) *physical_size = distinct * FS_BLOCK_SIZE;
+}
+
+const char* fs_get_file_type_string(const char* filename) {
+    int i = find_entry(filename);
+    if (i < 0) {
+        return "unknown";
     }
-    return "unknown";
+    return filesystem->entries[i].is_directory ? "directory" : "file";
 }
 
 void fs_get_permissions_string(const char* filename, char* perms, size_t size) {
-    for (uint32_t i = 0; i < filesystem.num_entries; i++) {
-        if (strcmp(filesystem.entries[i].filename, filename) == 0) {
-            uint32_t p = filesystem.entries[i].permissions;
-            snprintf(perms, size, "%c%c%c%c%c%c%c%c%c",
-                filesystem.entries[i].is_directory ? 'd' : '-',
-                (p & 0400) ? 'r' : '-',
-                (p & 0200) ? 'w' : '-',
-                (p & 0100) ? 'x' : '-',
-                (p & 0040) ? 'r' : '-',
-                (p & 0020) ? 'w' : '-',
-                (p & 0010) ? 'x' : '-',
-                (p & 0004) ? 'r' : '-',
-                (p & 0002) ? 'w' : '-'
-            );
-            return;
-        }
-    }
-    strcpy(perms, "---------");
+    int i = find_entry(filename);
+    if (i < 0) {
+        strcpy(perms, "---------");
+        return;
+    }
+    
+    uint32_t p = filesystem->entries[i].permissions;
+    snprintf(perms, size, "%c%c%c%c%c%c%c%c%c",
+        filesystem->entries[i].is_directory ? 'd' : '-',
+        (p & 0400) ? 'r' : '-',
+        (p & 0200) ? 'w' : '-',
+        (p & 0100) ? 'x' : '-',
+        (p & 0040) ? 'r' : '-',
+        (p & 0020) ? 'w' : '-',
+        (p & 0010) ? 'x' : '-',
+        (p & 0004) ? 'r' : '-',
+        (p & 0002) ? 'w' : '-'
+    );
 }
 
 filesystem_t* fs_get_instance(void) {
-    return &filesystem;
+    return filesystem;
+}
+
+filesystem_t* fs_use(filesystem_t* instance) {
+    filesystem_t* previous = filesystem;
+    filesystem = instance;
+    return previous;
+}
+
+const fs_entry_t* fs_lookup(const char* path) {
+    int i = find_entry(path);
+    
+    // Directories may be stored with or without a trailing slash
+    size_t len = strlen(path);
+    if (i < 0 && len > 0 && path[len - 1] != '/' && len < FS_MAX_FILENAME_LENGTH - 1) {
+        char with_slash[FS_MAX_FILENAME_LENGTH];
+        memcpy(with_slash, path, len);
+        with_slash[len] = '/';
+        with_slash[len + 1] = '\0';
+        i = find_entry(with_slash);
+    }
+    return i >= 0 ? &filesystem->entries[i] : NULL;
+}
+
+uint32_t fs_prefix_range(const char* prefix, uint32_t* first) {
+    size_t len = strlen(prefix);
+    uint32_t start = lower_bound(prefix);
+    
+    // Matching names are contiguous, so the end of the run is a second search
+    uint32_t low = start;
+    uint32_t high = filesystem->num_entries;
+    while (low < high) {
+        uint32_t mid = (low + high) / 2;
+        if (strncmp(filesystem->entries[filesystem->sorted[mid]].filename, prefix, len) == 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    *first = start;
+    return low - start;
+}
+
+const fs_entry_t* fs_entry_at(uint32_t position) {
+    return position < filesystem->num_entries ? &filesystem->entries[filesystem->sorted[position]] : NULL;
+}
+
+// True if path lies beneath the directory dir (stored with or without '/')
+static bool is_beneath(const char* path, const char* dir) {
+    size_t len = strlen(dir);
+    if (len > 0 && dir[len - 1] == '/') {
+        len--;
+    }
+    return strncmp(path, dir, len) == 0 && path[len] == '/' && path[len + 1] != '\0';
+}
+
+int fs_walk(const char* root, fs_walk_fn visit, void* context) {
+    static uint32_t totals[FS_MAX_FILES]; // By position in the walked run
+    static uint8_t depths[FS_MAX_FILES];
+    uint32_t open[FS_MAX_FILES];          // Positions of enclosing directories
+    char prefix[FS_MAX_FILENAME_LENGTH];
+    
+    fs_normalize_path(root, prefix, sizeof(prefix));
+    const fs_entry_t* dir = fs_lookup(prefix);
+    if (!dir || !dir->is_directory) {
+        return -1;
+    }
+    size_t len = strlen(prefix);
+    if (prefix[len - 1] != '/' && len < FS_MAX_FILENAME_LENGTH - 1) {
+        prefix[len++] = '/';
+        prefix[len] = '\0';
+    }
+    
+    // The run under the prefix is in depth-first order, the directory
+    // itself first if it is stored with a trailing '/'
+    uint32_t first;
+    uint32_t count = fs_prefix_range(prefix, &first);
+    if (count > 0 && strcmp(fs_entry_at(first)->filename, prefix) == 0) {
+        first++;
+        count--;
+    }
+    
+    // Sizes roll up into a directory when the run leaves it, so one scan
+    // finds every total; a second one hands them out parents first
+    uint32_t depth = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const fs_entry_t* entry = fs_entry_at(first + i);
+        while (depth > 0 && !is_beneath(entry->filename, fs_entry_at(first + open[depth - 1])->filename)) {
+            depth--;
+            if (depth > 0) {
+                totals[open[depth - 1]] += totals[open[depth]];
+            }
+        }
+        totals[i] = entry->is_directory ? 0 : entry->size;
+        if (entry->is_directory) {
+            open[depth++] = i;
+        } else if (depth > 0) {
+            totals[open[depth - 1]] += entry->size;
+        }
+        
+        // Depth counts path components, so entries whose parent directory
+        // is missing still line up
+        depths[i] = 0;
+        for (const char* c = entry->filename + len; *c; c++) {
+            if (*c == '/' && c[1] != '\0') {
+                depths[i]++;
+            }
+        }
+    }
+    while (depth > 1) {
+        depth--;
+        totals[open[depth - 1]] += totals[open[depth]];
+    }
+    
+    for (uint32_t i = 0; i < count; i++) {
+        if (visit(fs_entry_at(first + i), depths[i], totals[i], context) != 0) {
+            return i + 1;
+        }
+    }
+    return count;
+}
+
+uint32_t fs_entry_stored_size(const fs_entry_t* entry) {
+    return (entry->flags & FS_FLAG_COMPRESSED) ? entry->stored_size : entry->size;
+}
+
+int fs_set_compression(const char* filename, bool enable) {
+    const fs_entry_t* found = fs_lookup(filename);
+    if (!found) {
+        return -1; // File not found
+    }
+    uint32_t index = found - filesystem->entries;
+    fs_entry_t* entry = &filesystem->entries[index];
+    
+    uint8_t flags = enable ? (entry->flags | FS_FLAG_COMPRESS) : (entry->flags & ~FS_FLAG_COMPRESS);
+    if (entry->is_directory || entry->size == 0) {
+        entry->flags = flags;
+        log_entry(index);
+        return 0;
+    }
+    
+    // Rewrite the contents so they are stored the new way
+    static uint8_t contents[FS_MAX_FILE_SIZE];
+    int size = fs_read_at(entry->filename, 0, contents, sizeof(contents));
+    if (size < 0) {
+        return -3; // I/O error
+    }
+    // The write stores and logs the new flags; a failed one keeps the old
+    uint8_t old_flags = entry->flags;
+    entry->flags = flags;
+    if (fs_write_file(entry->filename, contents, size) != 0) {
+        entry->flags = old_flags;
+        return -2;
+    }
+    return 0;
+}
+
+int fs_snapshot_create(void) {
+    for (int id = 0; id < FS_MAX_SNAPSHOTS; id++) {
+        fs_snapshot_t* snap = &snapshots[id];
+        if (snap->instance) {
+            continue;
+        }
+        
+        // Only the table is copied; the data blocks are shared
+        snap->instance = filesystem;
+        snap->created_time = get_time();
+        snap->num_entries = filesystem->num_entries;
+        memcpy(snap->entries, filesystem->entries, filesystem->num_entries * sizeof(fs_entry_t));
+        ref_entries(snap->entries, snap->num_entries);
+        return id;
+    }
+    return -1; // No free snapshot slot
+}
+
+int fs_snapshot_restore(int id) {
+    if (id < 0 || id >= FS_MAX_SNAPSHOTS || snapshots[id].instance != filesystem) {
+        return -1; // No such snapshot of this instance
+    }
+    const fs_snapshot_t* snap = &snapshots[id];
+    
+    // Take the snapshot's references before dropping the live ones so
+    // blocks both map are never freed in between
+    ref_entries(snap->entries, snap->num_entries);
+    unref_entries(filesystem->entries, filesystem->num_entries);
+    memcpy(filesystem->entries, snap->entries, snap->num_entries * sizeof(fs_entry_t));
+    filesystem->num_entries = snap->num_entries;
+    rebuild_index();
+    
+    // The blocks are already on disk or in the log; only the table changed
+    for (uint32_t i = 0; i < filesystem->num_entries; i++) {
+        log_entry(i);
+    }
+    return 0;
+}
+
+int fs_snapshot_delete(int id) {
+    if (id < 0 || id >= FS_MAX_SNAPSHOTS || snapshots[id].instance != filesystem) {
+        return -1; // No such snapshot of this instance
+    }
+    unref_entries(snapshots[id].entries, snapshots[id].num_entries);
+    snapshots[id].instance = NULL;
+    return 0;
+}
+
+int fs_snapshot_info(int id, uint32_t* num_entries, uint32_t* created_time) {
+    if (id < 0 || id >= FS_MAX_SNAPSHOTS || snapshots[id].instance != filesystem) {
+        return -1;
+    }
+    if (num_entries) *num_entries = snapshots[id].num_entries;
+    if (created_time) *created_time = snapshots[id].created_time;
+    return 0;
+}
+
+
+// Point every reference to one block at another, and the other's at the
+// first when they trade places
+static void remap_blocks(fs_entry_t* entries, uint32_t num_entries, uint16_t from, uint16_t to, bool swap, bool log) {
+    for (uint32_t i = 0; i < num_entries; i++) {
+        if (entries[i].is_directory) {
+            continue;
+        }
+        bool changed = false;
+        for (uint32_t k = 0; k < block_count(fs_entry_stored_size(&entries[i])); k++) {
+            if (entries[i].blocks[k] == from) {
+                entries[i].blocks[k] = to;
+                changed = true;
+            } else if (swap && entries[i].blocks[k] == to) {
+                entries[i].blocks[k] = from;
+                changed = true;
+            }
+        }
+        if (changed && log) {
+            log_entry(i);
+        }
+    }
+}
+
+// Move a block to another position. A free target is simply taken; one in
+// use trades places with it.
+static int relocate_block(uint16_t from, uint16_t to) {
+    bool swap = filesystem->block_refs[to] != 0;
+    if (data_fault_in(from * FS_BLOCK_SIZE, FS_BLOCK_SIZE) != 0 ||
+        (swap && data_fault_in(to * FS_BLOCK_SIZE, FS_BLOCK_SIZE) != 0)) {
+        return -1;
+    }
+    
+    unindex_block(from);
+    unindex_block(to);
+    memcpy(block_buffer, filesystem->data + to * FS_BLOCK_SIZE, FS_BLOCK_SIZE);
+    data_write_prepare(to * FS_BLOCK_SIZE, FS_BLOCK_SIZE);
+    memcpy(filesystem->data + to * FS_BLOCK_SIZE, filesystem->data + from * FS_BLOCK_SIZE, FS_BLOCK_SIZE);
+    log_data(to * FS_BLOCK_SIZE, FS_BLOCK_SIZE);
+    if (swap) {
+        data_write_prepare(from * FS_BLOCK_SIZE, FS_BLOCK_SIZE);
+        memcpy(filesystem->data + from * FS_BLOCK_SIZE, block_buffer, FS_BLOCK_SIZE);
+        log_data(from * FS_BLOCK_SIZE, FS_BLOCK_SIZE);
+        index_block(from);
+    }
+    index_block(to);
+    
+    uint16_t refs = filesystem->block_refs[to];
+    filesystem->block_refs[to] = filesystem->block_refs[from];
+    filesystem->block_refs[from] = refs;
+    
+    remap_blocks(filesystem->entries, filesystem->num_entries, from, to, swap, true);
+    for (int id = 0; id < FS_MAX_SNAPSHOTS; id++) {
+        if (snapshots[id].instance == filesystem) {
+            remap_blocks(snapshots[id].entries, snapshots[id].num_entries, from, to, swap, false);
+        }
+    }
+    return 0;
+}
+
+int fs_compact_step(uint32_t max_moves) {
+    if (compacted == filesystem) {
+        return 0;
+    }
+    
+    // Walk the files in table order: each block belongs at the cursor, and
+    // everything below the cursor is already in place. A block shared with
+    // an earlier file stays where that file put it.
+    uint32_t moved = 0;
+    uint32_t cursor = 0;
+    for (uint32_t i = 0; i < filesystem->num_entries; i++) {
+        const fs_entry_t* entry = &filesystem->entries[i];
+        if (entry->is_directory) {
+            continue;
+        }
+        for (uint32_t k = 0; k < block_count(fs_entry_stored_size(entry)); k++) {
+            if (entry->blocks[k] < cursor) {
+                continue;
+            }
+            if (entry->blocks[k] != cursor) {
+                if (moved == max_moves) {
+                    return moved;
+                }
+                if (relocate_block(entry->blocks[k], cursor) != 0) {
+                    return -1; // I/O error
+                }
+                moved++;
+            }
+            cursor++;
+        }
+    }
+    
+    // Allocation continues after the packed files
+    filesystem->next_block = cursor;
+    compacted = filesystem;
+    return moved;
+}
+
+void fs_get_fragmentation(uint32_t* files, uint32_t* extents) {
+    uint32_t file_count = 0;
+    uint32_t extent_count = 0;
+    for (uint32_t i = 0; i < filesystem->num_entries; i++) {
+        const fs_entry_t* entry = &filesystem->entries[i];
+        uint32_t count = block_count(fs_entry_stored_size(entry));
+        if (entry->is_directory || count == 0) {
+            continue;
+        }
+        file_count++;
+        extent_count++;
+        for (uint32_t k = 1; k < count; k++) {
+            if (entry->blocks[k] != entry->blocks[k - 1] + 1) {
+                extent_count++;
+            }
+        }
+    }
+    if (files) *files = file_count;
+    if (extents) *extents = extent_count;
+}
+
+// Snapshots only describe memory; a loaded or mounted instance replaces it
+static void drop_snapshots(void) {
+    for (int id = 0; id < FS_MAX_SNAPSHOTS; id++) {
+        if (snapshots[id].instance == filesystem) {
+            snapshots[id].instance = NULL;
+        }
+    }
+}
+
+int fs_load_image(void* image, size_t size) {
+    const fs_image_header_t* header = (const fs_image_header_t*)image;
+    
+    if (image == NULL || size < sizeof(fs_image_header_t)) {
+        return -1; // Too small to hold a header
+    }
+    
+    if (header->magic != FS_IMAGE_MAGIC || header->version > FS_IMAGE_VERSION) {
+        return -2; // Not an Alpha filesystem image, or a newer one
+    }
+    
+    if (header->image_size != sizeof(filesystem_t) ||
+        header->header_size + header->image_size > size) {
+        return -3; // Built for a different layout or truncated
+    }
+    
+    // Adopt the image in place - no entries or data are copied
+    filesystem = (filesystem_t*)((uint8_t*)image + header->header_size);
+    drop_snapshots();
+    
+    // The block index and path order are saved with the image; only an
+    // image from an older version has to have them recomputed
+    if (header->version != FS_IMAGE_VERSION) {
+        rebuild_blocks();
+        rebuild_index();
+    }
+    return 0;
+}
+
+void fs_init_image_header(fs_image_header_t* header) {
+    header->magic = FS_IMAGE_MAGIC;
+    header->version = FS_IMAGE_VERSION;
+    header->header_size = sizeof(fs_image_header_t);
+    header->image_size = sizeof(filesystem_t);
+}
+
+#ifdef TEST_MODE
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Hosted backend: a host file mapped MAP_SHARED as the filesystem_t
+static void* backing_map = NULL;
+static size_t backing_size = 0;
+
+int fs_open_backing_file(const char* path) {
+    size_t size = sizeof(fs_image_header_t) + sizeof(filesystem_t);
+    
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return -1; // Cannot open backing file
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    
+    bool fresh = st.st_size == 0;
+    if (fresh && ftruncate(fd, size) != 0) {
+        close(fd);
+        return -2; // Cannot size backing file
+    }
+    
+    void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -3; // Mapping failed
+    }
+    
+    if (fresh) {
+        fs_init_image_header((fs_image_header_t*)map);
+    }
+    
+    if (fs_load_image(map, fresh ? size : (size_t)st.st_size) != 0) {
+        munmap(map, size);
+        return -4; // Not an image of this layout
+    }
+    
+    backing_map = map;
+    backing_size = size;
+    
+    // The file may have been left with references held by snapshots of an
+    // earlier run, which are gone now
+    if (!fresh) {
+        rebuild_blocks();
+        rebuild_index();
+    }
+    
+    // An image that never finished fs_init has no root entry yet
+    if (filesystem->num_entries == 0) {
+        fs_init();
+        fs_sync();
+        return 1;
+    }
+    return 0;
+}
+#endif
+
+int fs_journal_start(uint32_t checkpoint_sequence) {
+    journaling = false;
+    backed_instance = filesystem;
+    drop_snapshots();
+    
+    int replayed = journal_replay(fs_apply_record, checkpoint_sequence);
+    if (replayed < 0) {
+        return replayed;
+    }
+    rebuild_blocks();
+    rebuild_index();
+    
+    journaling = true;
+    return replayed;
+}
+
+int fs_commit(void) {
+    if (!journaling) {
+        return 0;
+    }
+    return journal_commit() == 0 ? 0 : -1;
+}
+
+int fs_sync(void) {
+    if (fs_commit() != 0 || fs_disk_sync() != 0) {
+        return -1;
+    }
+#ifdef TEST_MODE
+    if (backing_map && msync(backing_map, backing_size, MS_SYNC) != 0) {
+        return -1; // Write-back failed
+    }
+#endif
+    return 0;
 }
@@ -0,0 +1,276 @@
+#include "../include/kernel/fs_disk.h"
+#include "../include/kernel/bcache.h"
+#include "../include/kernel/journal.h"
+#include "../include/libc/string.h"
+
+#define SECTOR_SIZE BLOCKDEV_SECTOR_SIZE
+#define MAP_BYTES (FS_DISK_DATA_SECTORS / 8)
+
+static block_device_t* disk = NULL;
+static fs_superblock_t superblock;
+
+// Per data sector: holds file data on disk / loaded in memory / changed
+// since the last checkpoint
+static uint8_t alloc_map[MAP_BYTES];
+static uint8_t resident_map[MAP_BYTES];
+static uint8_t dirty_map[MAP_BYTES];
+static uint32_t resident_sectors = 0;
+
+static inline bool map_test(const uint8_t* map, uint32_t bit) {
+    return map[bit / 8] & (1 << (bit % 8));
+}
+
+static inline void map_set(uint8_t* map, uint32_t bit) {
+    map[bit / 8] |= 1 << (bit % 8);
+}
+
+static uint32_t block_align(uint32_t sectors) {
+    return (sectors + BCACHE_SECTORS_PER_BLOCK - 1) & ~(BCACHE_SECTORS_PER_BLOCK - 1);
+}
+
+static void compute_layout(fs_superblock_t* sb) {
+    memset(sb, 0, sizeof(fs_superblock_t));
+    sb->magic = FS_DISK_MAGIC;
+    sb->version = FS_DISK_VERSION;
+    sb->entry_size = sizeof(fs_entry_t);
+    sb->max_entries = FS_MAX_FILES;
+
+    sb->journal_start = BCACHE_SECTORS_PER_BLOCK; // The superblock has block 0 to itself
+    sb->journal_sectors = FS_DISK_JOURNAL_SECTORS;
+    sb->table_start = sb->journal_start + block_align(sb->journal_sectors);
+    sb->table_sectors = (FS_MAX_FILES * sizeof(fs_entry_t) + SECTOR_SIZE - 1) / SECTOR_SIZE;
+    sb->bitmap_start = sb->table_start + block_align(sb->table_sectors);
+    sb->bitmap_sectors = (MAP_BYTES + SECTOR_SIZE - 1) / SECTOR_SIZE;
+    sb->data_start = sb->bitmap_start + block_align(sb->bitmap_sectors);
+    sb->data_sectors = FS_DISK_DATA_SECTORS;
+}
+
+static void mark_range(uint8_t* map, uint32_t offset, uint32_t size) {
+    if (size == 0) {
+        return;
+    }
+    for (uint32_t s = offset / SECTOR_SIZE; s <= (offset + size - 1) / SECTOR_SIZE; s++) {
+        map_set(map, s);
+    }
+}
+
+static void mark_resident(uint32_t sector) {
+    if (!map_test(resident_map, sector)) {
+        map_set(resident_map, sector);
+        resident_sectors++;
+    }
+}
+
+// Journal checkpoint: write back changed data, then the table and bitmap,
+// and only once those are on disk the superblock that vouches for them
+static int fs_disk_checkpoint(uint32_t next_sequence) {
+    filesystem_t* fs = fs_get_instance();
+
+    uint32_t s = 0;
+    while (s < FS_DISK_DATA_SECTORS) {
+        if (!map_test(dirty_map, s)) {
+            s++;
+            continue;
+        }
+        uint32_t run = 1;
+        while (s + run < FS_DISK_DATA_SECTORS && map_test(dirty_map, s + run)) {
+            run++;
+        }
+        if (bcache_write(disk, superblock.data_start + s, 0,
+                         fs->data + s * SECTOR_SIZE, run * SECTOR_SIZE) != 0) {
+            return -1;
+        }
+        s += run;
+    }
+
+    memset(alloc_map, 0, sizeof(alloc_map));
+    for (uint32_t b = 0; b < FS_NUM_BLOCKS; b++) {
+        if (fs->block_refs[b]) {
+            mark_range(alloc_map, b * FS_BLOCK_SIZE, FS_BLOCK_SIZE);
+        }
+    }
+
+    if (bcache_write(disk, superblock.table_start, 0, fs->entries,
+                     fs->num_entries * sizeof(fs_entry_t)) != 0 ||
+        bcache_write(disk, superblock.bitmap_start, 0, alloc_map, sizeof(alloc_map)) != 0 ||
+        bcache_flush(disk) != 0) {
+        return -1;
+    }
+
+    superblock.num_entries = fs->num_entries;
+    superblock.data_used = fs->data_used;
+    superblock.checkpoint_sequence = next_sequence;
+    if (bcache_write(disk, 0, 0, &superblock, sizeof(superblock)) != 0 || bcache_flush(disk) != 0) {
+        return -1;
+    }
+
+    memset(dirty_map, 0, sizeof(dirty_map));
+    return 0;
+}
+
+int fs_disk_format(block_device_t* dev) {
+    fs_superblock_t sb;
+    compute_layout(&sb);
+    if (sb.data_start + sb.data_sectors > dev->sector_count) {
+        return -1; // Device too small
+    }
+
+    // Leave the previous disk consistent before switching
+    if (disk) {
+        fs_disk_sync();
+    }
+
+    if (journal_format(dev, sb.journal_start, sb.journal_sectors) != 0) {
+        return -2;
+    }
+    bcache_invalidate(dev);
+
+    // Everything in memory is authoritative and all of it is new
+    filesystem_t* fs = fs_get_instance();
+    disk = dev;
+    superblock = sb;
+    memset(resident_map, 0xFF, sizeof(resident_map));
+    resident_sectors = FS_DISK_DATA_SECTORS;
+    memset(dirty_map, 0, sizeof(dirty_map));
+    for (uint32_t b = 0; b < FS_NUM_BLOCKS; b++) {
+        if (fs->block_refs[b]) {
+            mark_range(dirty_map, b * FS_BLOCK_SIZE, FS_BLOCK_SIZE);
+        }
+    }
+
+    if (fs_disk_checkpoint(1) != 0 ||
+        journal_open(dev, sb.journal_start, sb.journal_sectors, fs_disk_checkpoint) != 0 ||
+        fs_journal_start(1) < 0) {
+        disk = NULL;
+        return -3;
+    }
+    return 0;
+}
+
+int fs_disk_mount(block_device_t* dev) {
+    fs_superblock_t sb;
+    if (dev->sector_count < BCACHE_SECTORS_PER_BLOCK || bcache_read(dev, 0, 0, &sb, sizeof(sb)) != 0) {
+        return -1;
+    }
+    if (sb.magic != FS_DISK_MAGIC || sb.version != FS_DISK_VERSION) {
+        return -2; // No file system on this device
+    }
+    if (sb.entry_size != sizeof(fs_entry_t) || sb.max_entries != FS_MAX_FILES ||
+        sb.data_sectors != FS_DISK_DATA_SECTORS || sb.num_entries > FS_MAX_FILES ||
+        sb.data_start + sb.data_sectors > dev->sector_count) {
+        return -3; // Formatted with a different layout
+    }
+
+    // Only the used part of the table is read; data stays on disk
+    filesystem_t* fs = fs_get_instance();
+    if (bcache_read(dev, sb.table_start, 0, fs->entries, sb.num_entries * sizeof(fs_entry_t)) != 0 ||
+        bcache_read(dev, sb.bitmap_start, 0, alloc_map, sizeof(alloc_map)) != 0) {
+        return -1;
+    }
+    fs->num_entries = sb.num_entries;
+    fs->data_used = sb.data_used;
+    strcpy(fs->current_path, "/");
+
+    disk = dev;
+    superblock = sb;
+    memset(resident_map, 0, sizeof(resident_map));
+    memset(dirty_map, 0, sizeof(dirty_map));
+    resident_sectors = 0;
+
+    if (journal_open(dev, sb.journal_start, sb.journal_sectors, fs_disk_checkpoint) != 0) {
+        disk = NULL;
+        return -4;
+    }
+    int replayed = fs_journal_start(sb.checkpoint_sequence);
+    if (replayed < 0) {
+        disk = NULL;
+        return -4;
+    }
+    return replayed;
+}
+
+int fs_disk_sync(void) {
+    if (!disk) {
+        return 0;
+    }
+    return journal_checkpoint();
+}
+
+int fs_disk_fault_in(uint32_t offset, uint32_t size) {
+    if (!disk || size == 0) {
+        return 0;
+    }
+
+    filesystem_t* fs = fs_get_instance();
+    uint32_t last = (offset + size - 1) / SECTOR_SIZE;
+    uint32_t s = offset / SECTOR_SIZE;
+
+    while (s <= last) {
+        if (map_test(resident_map, s)) {
+            s++;
+            continue;
+        }
+        if (!map_test(alloc_map, s)) {
+            // Never written: nothing to read
+            memset(fs->data + s * SECTOR_SIZE, 0, SECTOR_SIZE);
+            mark_resident(s);
+            s++;
+            continue;
+        }
+
+        // Load each run of missing sectors with one cache read
+        uint32_t run = 1;
+        while (s + run <= last && !map_test(resident_map, s + run) && map_test(alloc_map, s + run)) {
+            run++;
+        }
+        if (bcache_read(disk, superblock.data_start + s, 0,
+                        fs->data + s * SECTOR_SIZE, run * SECTOR_SIZE) != 0) {
+            return -1;
+        }
+        for (uint32_t k = 0; k < run; k++) {
+            mark_resident(s + k);
+        }
+        s += run;
+    }
+    return 0;
+}
+
+int fs_disk_write_prepare(uint32_t offset, uint32_t size) {
+    if (!disk || size == 0) {
+        return 0;
+    }
+
+    // Sectors only partly overwritten keep bytes of their neighbours
+    if ((offset % SECTOR_SIZE) != 0 && fs_disk_fault_in(offset, 1) != 0) {
+        return -1;
+    }
+    if (((offset + size) % SECTOR_SIZE) != 0 && fs_disk_fault_in(offset + size - 1, 1) != 0) {
+        return -1;
+    }
+
+    for (uint32_t s = offset / SECTOR_SIZE; s <= (offset + size - 1) / SECTOR_SIZE; s++) {
+        mark_resident(s);
+    }
+    mark_range(dirty_map, offset, size);
+    return 0;
+}
+
+bool fs_disk_is_resident(uint32_t offset, uint32_t size) {
+    if (!disk || size == 0) {
+        return true;
+    }
+    for (uint32_t s = offset / SECTOR_SIZE; s <= (offset + size - 1) / SECTOR_SIZE; s++) {
+        if (!map_test(resident_map, s)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+block_device_t* fs_disk_get_device(void) {
+    return disk;
+}
+
+uint32_t fs_disk_resident_sectors(void) {
+    return resident_sectors;
+}
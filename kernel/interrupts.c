@@ -0,0 +1,175 @@
+#include "../include/kernel/interrupts.h"
+#include "../include/kernel/console.h"
+#include "../include/kernel/serial.h"
+#include "../include/kernel/system.h"
+#include "../include/libc/stdio.h"
+
+#ifdef TEST_MODE
+// Test mode - there is no interrupt hardware to program
+
+void interrupts_init(void) {
+}
+
+void irq_register_handler(uint8_t irq, irq_handler_t handler) {
+    (void)irq;
+    (void)handler;
+}
+
+uint32_t irq_get_count(uint8_t irq) {
+    (void)irq;
+    return 0;
+}
+
+void interrupt_dispatch(interrupt_frame_t* frame) {
+    (void)frame;
+}
+
+#else
+// Kernel mode implementation
+
+#define IDT_ENTRIES 256
+#define IDT_STUBS (IRQ_BASE_VECTOR + IRQ_COUNT)
+#define IDT_INTERRUPT_GATE 0x8E  // Present, ring 0, 32-bit interrupt gate
+
+// 8259 PIC ports and commands
+#define PIC1_COMMAND 0x20
+#define PIC1_DATA    0x21
+#define PIC2_COMMAND 0xA0
+#define PIC2_DATA    0xA1
+#define PIC_EOI      0x20
+#define PIC_READ_ISR 0x0B
+
+typedef struct {
+    uint16_t offset_low;
+    uint16_t selector;
+    uint8_t zero;
+    uint8_t type_attr;
+    uint16_t offset_high;
+} __attribute__((packed)) idt_entry_t;
+
+typedef struct {
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed)) idt_pointer_t;
+
+// Entry stubs from arch/x86/isr.asm
+extern uint32_t interrupt_stub_table[IDT_STUBS];
+
+static idt_entry_t idt[IDT_ENTRIES];
+static irq_handler_t irq_handlers[IRQ_COUNT];
+static volatile uint32_t irq_counts[IRQ_COUNT];
+static uint16_t irq_mask = 0xFFFF;
+
+static const char* exception_names[32] = {
+    "Divide error", "Debug", "NMI", "Breakpoint", "Overflow", "Bound range",
+    "Invalid opcode", "Device not available", "Double fault", "Coprocessor overrun",
+    "Invalid TSS", "Segment not present", "Stack fault", "General protection",
+    "Page fault", "Reserved", "x87 FPU error", "Alignment check", "Machine check",
+    "SIMD exception", "Virtualization", "Control protection", "Reserved", "Reserved",
+    "Reserved", "Reserved", "Reserved", "Reserved", "Hypervisor injection",
+    "VMM communication", "Security exception", "Reserved"
+};
+
+static void idt_set_gate(uint8_t vector, uint32_t handler, uint16_t selector) {
+    idt[vector].offset_low = handler & 0xFFFF;
+    idt[vector].selector = selector;
+    idt[vector].zero = 0;
+    idt[vector].type_attr = IDT_INTERRUPT_GATE;
+    idt[vector].offset_high = (handler >> 16) & 0xFFFF;
+}
+
+static void pic_apply_mask(void) {
+    outb(PIC1_DATA, irq_mask & 0xFF);
+    outb(PIC2_DATA, irq_mask >> 8);
+}
+
+// Move IRQs 0-15 to vectors 32-47, clear of the CPU exceptions
+static void pic_remap(void) {
+    outb(PIC1_COMMAND, 0x11); io_wait();  // ICW1: init, expect ICW4
+    outb(PIC2_COMMAND, 0x11); io_wait();
+    outb(PIC1_DATA, IRQ_BASE_VECTOR); io_wait();      // ICW2: vector offsets
+    outb(PIC2_DATA, IRQ_BASE_VECTOR + 8); io_wait();
+    outb(PIC1_DATA, 0x04); io_wait();     // ICW3: slave on IRQ2
+    outb(PIC2_DATA, 0x02); io_wait();
+    outb(PIC1_DATA, 0x01); io_wait();     // ICW4: 8086 mode
+    outb(PIC2_DATA, 0x01); io_wait();
+    pic_apply_mask();
+}
+
+void interrupts_init(void) {
+    for (int i = 0; i < IDT_STUBS; i++) {
+        idt_set_gate(i, interrupt_stub_table[i], KERNEL_CODE_SELECTOR);
+    }
+
+    idt_pointer_t idtr;
+    idtr.limit = sizeof(idt) - 1;
+    idtr.base = (uint32_t)idt;
+    __asm__ volatile ("lidt %0" : : "m"(idtr));
+
+    pic_remap();
+}
+
+void irq_register_handler(uint8_t irq, irq_handler_t handler) {
+    if (irq >= IRQ_COUNT) {
+        return;
+    }
+
+    irq_handlers[irq] = handler;
+    irq_mask &= ~(1 << irq);
+    if (irq >= 8) {
+        irq_mask &= ~(1 << IRQ_CASCADE);
+    }
+    pic_apply_mask();
+}
+
+uint32_t irq_get_count(uint8_t irq) {
+    return irq < IRQ_COUNT ? irq_counts[irq] : 0;
+}
+
+static void exception_panic(interrupt_frame_t* frame) {
+    console_set_color(VGA_COLOR_WHITE, VGA_COLOR_RED);
+    printf("\nKERNEL PANIC: %s (vector %u, error %x) at eip %x\n",
+           exception_names[frame->vector], frame->vector, frame->error_code, frame->eip);
+    serial_flush(); // The transmit interrupt will not run again
+    system_halt();
+}
+
+// The PIC raises IRQ7/IRQ15 for glitches without setting the in-service bit
+static bool irq_is_spurious(uint8_t irq) {
+    if (irq == 7) {
+        outb(PIC1_COMMAND, PIC_READ_ISR);
+        return !(inb(PIC1_COMMAND) & 0x80);
+    }
+    if (irq == 15) {
+        outb(PIC2_COMMAND, PIC_READ_ISR);
+        if (!(inb(PIC2_COMMAND) & 0x80)) {
+            outb(PIC1_COMMAND, PIC_EOI); // Master still saw the cascade
+            return true;
+        }
+    }
+    return false;
+}
+
+void interrupt_dispatch(interrupt_frame_t* frame) {
+    if (frame->vector < IRQ_BASE_VECTOR) {
+        exception_panic(frame);
+        return;
+    }
+
+    uint8_t irq = frame->vector - IRQ_BASE_VECTOR;
+    if (irq >= IRQ_COUNT || irq_is_spurious(irq)) {
+        return;
+    }
+
+    irq_counts[irq]++;
+    if (irq_handlers[irq]) {
+        irq_handlers[irq](frame);
+    }
+
+    if (irq >= 8) {
+        outb(PIC2_COMMAND, PIC_EOI);
+    }
+    outb(PIC1_COMMAND, PIC_EOI);
+}
+
+#endif
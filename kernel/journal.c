@@ -0,0 +1,255 @@
+#include "../include/kernel/journal.h"
+#include "../include/libc/string.h"
+
+#define TX_HEADER_SIZE sizeof(journal_tx_header_t)
+#define RECORD_SPACE(length) (sizeof(journal_record_t) + (((length) + 3) & ~3u))
+
+static block_device_t* journal_dev = NULL;
+static uint32_t journal_start = 0;
+static uint32_t journal_sectors = 0;
+static journal_checkpoint_t checkpoint_fn = NULL;
+
+static uint32_t head = 1;            // Sector offset of the next transaction
+static uint32_t next_sequence = 1;
+
+// The open transaction is built in place behind its header, so a commit
+// is a single device write of this buffer
+static uint8_t tx_buffer[JOURNAL_TX_SIZE] __attribute__((aligned(16)));
+static uint32_t tx_used = 0;
+static uint32_t tx_records = 0;
+static bool tx_overflow = false;     // A record did not fit; commit checkpoints
+
+static journal_stats_t stats;
+static uint32_t crc_table[256];
+
+static void crc32_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+        }
+        crc_table[i] = c;
+    }
+}
+
+static uint32_t crc32(const uint8_t* data, uint32_t length) {
+    uint32_t c = 0xFFFFFFFF;
+    for (uint32_t i = 0; i < length; i++) {
+        c = crc_table[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+    }
+    return c ^ 0xFFFFFFFF;
+}
+
+static uint32_t tx_sectors(uint32_t length) {
+    return (TX_HEADER_SIZE + length + BLOCKDEV_SECTOR_SIZE - 1) / BLOCKDEV_SECTOR_SIZE;
+}
+
+static void tx_reset(void) {
+    tx_used = 0;
+    tx_records = 0;
+    tx_overflow = false;
+}
+
+// Write the log header; with clear_first the first transaction slot is
+// zeroed too, so nothing left from an earlier log can pass for its start
+static int write_header(block_device_t* dev, uint32_t start_lba, uint32_t sequence, bool clear_first) {
+    uint8_t sectors[2 * BLOCKDEV_SECTOR_SIZE];
+    memset(sectors, 0, sizeof(sectors));
+
+    journal_header_t* header = (journal_header_t*)sectors;
+    header->magic = JOURNAL_MAGIC;
+    header->sequence = sequence;
+    return blockdev_write(dev, start_lba, clear_first ? 2 : 1, sectors);
+}
+
+int journal_format(block_device_t* dev, uint32_t start_lba, uint32_t num_sectors) {
+    if (num_sectors < 2 + JOURNAL_TX_SIZE / BLOCKDEV_SECTOR_SIZE) {
+        return -1; // Too small for one full transaction
+    }
+    return write_header(dev, start_lba, 1, true) == 0 ? 0 : -3;
+}
+
+int journal_open(block_device_t* dev, uint32_t start_lba, uint32_t num_sectors,
+                 journal_checkpoint_t checkpoint) {
+    uint8_t sector[BLOCKDEV_SECTOR_SIZE];
+    if (blockdev_read(dev, start_lba, 1, sector) != 0) {
+        return -1;
+    }
+
+    const journal_header_t* header = (const journal_header_t*)sector;
+    if (header->magic != JOURNAL_MAGIC) {
+        return -2; // Not formatted
+    }
+
+    crc32_init();
+    journal_dev = dev;
+    journal_start = start_lba;
+    journal_sectors = num_sectors;
+    checkpoint_fn = checkpoint;
+    head = 1;
+    next_sequence = header->sequence;
+    memset(&stats, 0, sizeof(stats));
+    tx_reset();
+    return 0;
+}
+
+int journal_replay(journal_apply_t apply, uint32_t checkpoint_sequence) {
+    if (!journal_dev) {
+        return -1;
+    }
+
+    const journal_tx_header_t* tx = (const journal_tx_header_t*)tx_buffer;
+    uint32_t pos = 1;
+    uint32_t sequence = next_sequence;
+    int replayed = 0;
+
+    // The log ends at the first transaction that is missing, stale from an
+    // earlier pass over the region, or torn
+    while (pos < journal_sectors) {
+        if (blockdev_read(journal_dev, journal_start + pos, 1, tx_buffer) != 0) {
+            return -1;
+        }
+        if (tx->magic != JOURNAL_TX_MAGIC || tx->sequence != sequence ||
+            tx->length > JOURNAL_TX_SIZE - TX_HEADER_SIZE) {
+            break;
+        }
+
+        uint32_t sectors = tx_sectors(tx->length);
+        if (pos + sectors > journal_sectors) {
+            break;
+        }
+        if (sectors > 1 && blockdev_read(journal_dev, journal_start + pos + 1, sectors - 1,
+                                         tx_buffer + BLOCKDEV_SECTOR_SIZE) != 0) {
+            return -1;
+        }
+        if (crc32(tx_buffer + TX_HEADER_SIZE, tx->length) != tx->checksum) {
+            break;
+        }
+
+        if (sequence >= checkpoint_sequence) {
+            uint32_t offset = 0;
+            for (uint32_t r = 0; r < tx->num_records; r++) {
+                const journal_record_t* rec = (const journal_record_t*)(tx_buffer + TX_HEADER_SIZE + offset);
+                if (offset + RECORD_SPACE(rec->length) > tx->length) {
+                    break;
+                }
+                if (apply(rec->type, rec + 1, rec->length) != 0) {
+                    return -2; // The log describes a state we cannot rebuild
+                }
+                offset += RECORD_SPACE(rec->length);
+            }
+            replayed++;
+        }
+
+        pos += sectors;
+        sequence++;
+    }
+
+    head = pos;
+    next_sequence = sequence;
+    tx_reset();
+
+    // The home state is newer than the whole log: start a fresh one so new
+    // transactions are not mistaken for already checkpointed ones
+    if (next_sequence < checkpoint_sequence) {
+        if (write_header(journal_dev, journal_start, checkpoint_sequence, false) != 0) {
+            return -1;
+        }
+        head = 1;
+        next_sequence = checkpoint_sequence;
+    }
+
+    return replayed;
+}
+
+void* journal_reserve(uint16_t type, uint32_t length) {
+    uint32_t needed = RECORD_SPACE(length);
+
+    if (!journal_dev || tx_overflow) {
+        return NULL;
+    }
+    if (TX_HEADER_SIZE + tx_used + needed > JOURNAL_TX_SIZE) {
+        // Committing here could log half an operation; the caller's next
+        // commit, at an operation boundary, checkpoints instead
+        tx_overflow = true;
+        return NULL;
+    }
+
+    journal_record_t* rec = (journal_record_t*)(tx_buffer + TX_HEADER_SIZE + tx_used);
+    rec->type = type;
+    rec->reserved = 0;
+    rec->length = length;
+    memset((uint8_t*)rec + needed - 4, 0, 4); // Clear the padding
+
+    tx_used += needed;
+    tx_records++;
+    return rec + 1;
+}
+
+int journal_commit(void) {
+    if (!journal_dev) {
+        return -1;
+    }
+    if (tx_overflow) {
+        // Too big to log: the checkpoint writes the state it describes
+        return journal_checkpoint();
+    }
+    if (tx_records == 0) {
+        return 0;
+    }
+
+    uint32_t sectors = tx_sectors(tx_used);
+    if (head + sectors > journal_sectors) {
+        // Log full: likewise
+        return journal_checkpoint();
+    }
+
+    journal_tx_header_t* tx = (journal_tx_header_t*)tx_buffer;
+    tx->magic = JOURNAL_TX_MAGIC;
+    tx->sequence = next_sequence;
+    tx->num_records = tx_records;
+    tx->length = tx_used;
+    tx->checksum = crc32(tx_buffer + TX_HEADER_SIZE, tx_used);
+    memset(tx_buffer + TX_HEADER_SIZE + tx_used, 0,
+           sectors * BLOCKDEV_SECTOR_SIZE - TX_HEADER_SIZE - tx_used);
+
+    if (blockdev_write(journal_dev, journal_start + head, sectors, tx_buffer) != 0) {
+        return -1; // The transaction stays open for the next attempt
+    }
+
+    head += sectors;
+    next_sequence++;
+    stats.transactions++;
+    stats.records += tx_records;
+    stats.sectors_written += sectors;
+    tx_reset();
+    return 0;
+}
+
+int journal_checkpoint(void) {
+    if (!journal_dev || !checkpoint_fn) {
+        return -1;
+    }
+
+    uint32_t sequence = next_sequence;
+    if (checkpoint_fn(sequence) != 0) {
+        return -1;
+    }
+    if (write_header(journal_dev, journal_start, sequence, false) != 0) {
+        return -1;
+    }
+
+    // Whatever was still open is now part of the home state
+    head = 1;
+    tx_reset();
+    stats.checkpoints++;
+    return 0;
+}
+
+bool journal_is_open(void) {
+    return journal_dev != NULL;
+}
+
+void journal_get_stats(journal_stats_t* out) {
+    *out = stats;
+}
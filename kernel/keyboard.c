@@ -1,6 +1,7 @@
 #include "../include/kernel/keyboard.h"
 #include "../include/kernel/system.h"
 #include "../include/kernel/console.h" 
+#include "../include/kernel/serial.h"
 #include "../include/libc/string.h"
 
 #ifdef TEST_MODE
@@ -28,6 +29,7 @@ void keyboard_init(void) {
 
 char keyboard_read(void) {
     char c;
+    console_flush();
     if (read(STDIN_FILENO, &c, 1) == 1) {
         return c;
     }
@@ -50,6 +52,7 @@ int keyboard_get_line(char* buffer, size_t buffer_size) {
     char c;
     
     while (pos < buffer_size - 1) {
+        console_flush(); // Show the prompt and echo before waiting
         c = getchar();
         
         if (c == '\n' || c == '\r') {
@@ -58,12 +61,10 @@ int keyboard_get_line(char* buffer, size_t buffer_size) {
             if (pos > 0) {
                 pos--;
                 printf("\b \b"); // Erase character on screen
-                fflush(stdout);
             }
         } else if (c >= ' ' && c <= '~') { // Printable characters
             buffer[pos++] = c;
             putchar(c);
-            fflush(stdout);
         }
     }
     
@@ -83,6 +84,11 @@ void keyboard_poll(void) {
     // In test mode, polling is handled by the terminal
 }
 
+void keyboard_set_idle_handler(void (*handler)(void)) {
+    // Input blocks in getchar(), so there is no idle time to hand out
+    (void)handler;
+}
+
 // Cleanup function for test mode
 void keyboard_cleanup(void) {
     if (termios_saved) {
@@ -102,6 +108,20 @@ static char keyboard_buffer[KEYBOARD_BUFFER_SIZE];
 static int keyboard_buffer_head = 0;
 static int keyboard_buffer_tail = 0;
 
+static void (*idle_handler)(void) = NULL;
+
+// Keys handled here instead of queued: Shift+PgUp/PgDn page through the
+// console scrollback half a screen at a time, as on Linux
+#define SCANCODE_EXTENDED     0xE0
+#define SCANCODE_LEFT_SHIFT   0x2A
+#define SCANCODE_RIGHT_SHIFT  0x36
+#define SCANCODE_PAGE_UP      0x49
+#define SCANCODE_PAGE_DOWN    0x51
+#define SCROLLBACK_PAGE_LINES 12
+
+static bool shift_down = false;
+static bool extended = false;
+
 // US keyboard layout
 static const char keyboard_us[128] = {
     0, 27, '1', '2', '3', '4', '5', '6', '7', '8', '9', '0', '-', '=', '\b',
@@ -136,9 +156,12 @@ int keyboard_get_line(char* buffer, size_t buffer_size) {
     char c;
     
     while (pos < buffer_size - 1) {
-        // Poll for input
+        // Poll for input, handing the waiting time to the idle handler
         while (!keyboard_available()) {
             keyboard_poll();
+            if (idle_handler && !keyboard_available()) {
+                idle_handler();
+            }
         }
         
         c = keyboard_read();
@@ -168,22 +191,58 @@ void keyboard_clear_buffer(void) {
     keyboard_buffer_head = keyboard_buffer_tail;
 }
 
+void keyboard_set_idle_handler(void (*handler)(void)) {
+    idle_handler = handler;
+}
+
+static void keyboard_buffer_put(char c) {
+    int next_head = (keyboard_buffer_head + 1) % KEYBOARD_BUFFER_SIZE;
+    if (next_head != keyboard_buffer_tail) {
+        keyboard_buffer[keyboard_buffer_head] = c;
+        keyboard_buffer_head = next_head;
+    }
+}
+
 void keyboard_poll(void) {
+    // A terminal on the serial port types too; its Backspace sends DEL
+    int serial;
+    while ((serial = serial_read()) >= 0) {
+        keyboard_buffer_put(serial == KEY_DELETE ? KEY_BACKSPACE : serial);
+    }
+    
     uint8_t status = inb(KEYBOARD_STATUS_PORT);
     
     if (status & 0x01) {
         uint8_t scancode = inb(KEYBOARD_DATA_PORT);
         
+        if (scancode == SCANCODE_EXTENDED) {
+            extended = true;
+            return;
+        }
+        bool was_extended = extended;
+        extended = false;
+        
+        uint8_t key = scancode & 0x7F;
+        if (key == SCANCODE_LEFT_SHIFT || key == SCANCODE_RIGHT_SHIFT) {
+            // Some keyboards wrap extended keys in fake shifts: ignore those
+            if (!was_extended) {
+                shift_down = !(scancode & 0x80);
+            }
+            return;
+        }
+        if (was_extended && shift_down && (key == SCANCODE_PAGE_UP || key == SCANCODE_PAGE_DOWN)) {
+            if (!(scancode & 0x80)) {
+                console_scroll_view(key == SCANCODE_PAGE_UP ? SCROLLBACK_PAGE_LINES : -SCROLLBACK_PAGE_LINES);
+            }
+            return;
+        }
+        
         // Only process key press events (not key release)
         if (!(scancode & 0x80)) {
             char c = keyboard_us[scancode];
             
             if (c) {
-                int next_head = (keyboard_buffer_head + 1) % KEYBOARD_BUFFER_SIZE;
-                if (next_head != keyboard_buffer_tail) {
-                    keyboard_buffer[keyboard_buffer_head] = c;
-                    keyboard_buffer_head = next_head;
-                }
+                keyboard_buffer_put(c);
             }
         }
     }
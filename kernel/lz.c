@@ -0,0 +1,163 @@
+#include "../include/kernel/lz.h"
+#include "../include/libc/string.h"
+
+#define MIN_MATCH 4
+#define HASH_BITS 12
+#define MAX_OFFSET 65535
+
+// Most recent position + 1 of each hashed 4-byte prefix (0 = none)
+static uint16_t hash_table[1 << HASH_BITS];
+
+static uint32_t hash4(const uint8_t* p) {
+    uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Lengths of 15 and up continue in extra bytes of 255 plus a final remainder
+static bool put_length(uint8_t** op, const uint8_t* end, uint32_t length) {
+    while (length >= 255) {
+        if (*op >= end) {
+            return false;
+        }
+        *(*op)++ = 255;
+        length -= 255;
+    }
+    if (*op >= end) {
+        return false;
+    }
+    *(*op)++ = length;
+    return true;
+}
+
+static bool put_sequence(uint8_t** op, const uint8_t* end, const uint8_t* literals,
+                         uint32_t literal_length, uint32_t offset, uint32_t match_length) {
+    if (*op >= end) {
+        return false;
+    }
+    uint8_t* token = (*op)++;
+    uint32_t match_code = match_length ? match_length - MIN_MATCH : 0;
+    *token = ((literal_length < 15 ? literal_length : 15) << 4) | (match_code < 15 ? match_code : 15);
+
+    if (literal_length >= 15 && !put_length(op, end, literal_length - 15)) {
+        return false;
+    }
+    if ((uint32_t)(end - *op) < literal_length) {
+        return false;
+    }
+    memcpy(*op, literals, literal_length);
+    *op += literal_length;
+
+    if (match_length == 0) {
+        return true; // Final sequence: literals only
+    }
+    if (end - *op < 2) {
+        return false;
+    }
+    *(*op)++ = offset & 0xFF;
+    *(*op)++ = offset >> 8;
+    return match_code < 15 || put_length(op, end, match_code - 15);
+}
+
+int lz_compress(const uint8_t* src, uint32_t size, uint8_t* dst, uint32_t capacity) {
+    if (size > LZ_MAX_INPUT) {
+        return -1;
+    }
+
+    uint8_t* op = dst;
+    const uint8_t* end = dst + capacity;
+    uint32_t anchor = 0;
+    uint32_t ip = 0;
+
+    memset(hash_table, 0, sizeof(hash_table));
+    while (ip + MIN_MATCH <= size) {
+        uint32_t h = hash4(src + ip);
+        uint32_t candidate = hash_table[h];
+        hash_table[h] = ip + 1;
+
+        if (candidate == 0 || ip - (candidate - 1) > MAX_OFFSET ||
+            memcmp(src + candidate - 1, src + ip, MIN_MATCH) != 0) {
+            ip++;
+            continue;
+        }
+
+        uint32_t match = candidate - 1;
+        uint32_t length = MIN_MATCH;
+        while (ip + length < size && src[match + length] == src[ip + length]) {
+            length++;
+        }
+
+        if (!put_sequence(&op, end, src + anchor, ip - anchor, ip - match, length)) {
+            return -1;
+        }
+        ip += length;
+        anchor = ip;
+    }
+
+    if (!put_sequence(&op, end, src + anchor, size - anchor, 0, 0)) {
+        return -1;
+    }
+    return op - dst;
+}
+
+static bool get_length(const uint8_t** ip, const uint8_t* end, uint32_t* length) {
+    uint8_t b;
+    do {
+        if (*ip >= end) {
+            return false;
+        }
+        b = *(*ip)++;
+        *length += b;
+    } while (b == 255);
+    return true;
+}
+
+int lz_decompress(const uint8_t* src, uint32_t size, uint8_t* dst, uint32_t capacity) {
+    const uint8_t* ip = src;
+    const uint8_t* end = src + size;
+    uint32_t op = 0;
+
+    while (ip < end) {
+        uint8_t token = *ip++;
+
+        uint32_t literal_length = token >> 4;
+        if (literal_length == 15 && !get_length(&ip, end, &literal_length)) {
+            return -1;
+        }
+        if ((uint32_t)(end - ip) < literal_length || capacity - op < literal_length) {
+            return -1;
+        }
+        memcpy(dst + op, ip, literal_length);
+        ip += literal_length;
+        op += literal_length;
+
+        if (ip == end) {
+            break; // The final sequence has no match
+        }
+
+        if (end - ip < 2) {
+            return -1;
+        }
+        uint32_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        uint32_t match_length = token & 0x0F;
+        if (match_length == 15 && !get_length(&ip, end, &match_length)) {
+            return -1;
+        }
+        match_length += MIN_MATCH;
+        if (offset == 0 || offset > op || capacity - op < match_length) {
+            return -1;
+        }
+
+        // Matches may overlap their own output (runs), so copy forwards
+        const uint8_t* from = dst + op - offset;
+        if (offset >= match_length) {
+            memcpy(dst + op, from, match_length);
+        } else {
+            for (uint32_t i = 0; i < match_length; i++) {
+                dst[op + i] = from[i];
+            }
+        }
+        op += match_length;
+    }
+    return op;
+}
@@ -1,20 +1,98 @@
+#include "../include/kernel/ata.h"
+#include "../include/kernel/bcache.h"
 #include "../include/kernel/console.h"
 #include "../include/kernel/fs.h"
+#include "../include/kernel/fs_disk.h"
 #include "../include/kernel/keyboard.h"
 #include "../include/kernel/memory.h"
+#include "../include/kernel/multiboot.h"
+#include "../include/kernel/pci.h"
+#include "../include/kernel/serial.h"
 #include "../include/kernel/shell.h"
 #include "../include/kernel/system.h"
+#include "../include/kernel/vfs.h"
+#include "../include/kernel/virtio_blk.h"
 #include "../include/libc/stdio.h"
 #include "../include/libc/string.h"
 
 #ifndef TEST_MODE
+// Adopt the first boot module that is a valid filesystem image
+static bool load_boot_image(uint32_t magic, multiboot_info_t* mbi) {
+    if (magic != MULTIBOOT_BOOTLOADER_MAGIC || !(mbi->flags & MULTIBOOT_INFO_MODS)) {
+        return false;
+    }
+    
+    multiboot_module_t* mods = (multiboot_module_t*)mbi->mods_addr;
+    for (uint32_t i = 0; i < mbi->mods_count; i++) {
+        if (fs_load_image((void*)mods[i].mod_start, mods[i].mod_end - mods[i].mod_start) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Draw the console into the framebuffer the boot loader set up, if any
+static bool use_boot_framebuffer(uint32_t magic, multiboot_info_t* mbi) {
+    if (magic != MULTIBOOT_BOOTLOADER_MAGIC || !(mbi->flags & MULTIBOOT_INFO_FRAMEBUFFER) ||
+        mbi->framebuffer_type != MULTIBOOT_FRAMEBUFFER_TYPE_RGB || (mbi->framebuffer_addr >> 32) != 0) {
+        return false;
+    }
+    
+    console_framebuffer_t fb = {
+        (uint32_t)mbi->framebuffer_addr, mbi->framebuffer_pitch,
+        mbi->framebuffer_width, mbi->framebuffer_height, mbi->framebuffer_bpp,
+        mbi->framebuffer_red_field_position, mbi->framebuffer_red_mask_size,
+        mbi->framebuffer_green_field_position, mbi->framebuffer_green_mask_size,
+        mbi->framebuffer_blue_field_position, mbi->framebuffer_blue_mask_size,
+    };
+    return console_use_framebuffer(&fb) == 0;
+}
+
+// Console outputs from the kernel command line: the screen by default,
+// console=serial for COM1 only and console=both to mirror the screen there.
+// Mirroring is opt-in because a full transmit ring paces every write to
+// the baud rate.
+static unsigned console_outputs_from_cmdline(uint32_t magic, multiboot_info_t* mbi) {
+    unsigned outputs = CONSOLE_OUTPUT_VGA;
+    if (magic == MULTIBOOT_BOOTLOADER_MAGIC && (mbi->flags & MULTIBOOT_INFO_CMDLINE)) {
+        const char* cmdline = (const char*)mbi->cmdline;
+        if (strstr(cmdline, "console=serial")) {
+            outputs = CONSOLE_OUTPUT_SERIAL;
+        } else if (strstr(cmdline, "console=both")) {
+            outputs = CONSOLE_OUTPUT_VGA | CONSOLE_OUTPUT_SERIAL;
+        }
+    }
+    return outputs;
+}
+
+// Mount the first disk that holds an Alpha file system
+static block_device_t* mount_root_disk(int* replayed) {
+    for (int i = 0; i < blockdev_count(); i++) {
+        block_device_t* dev = blockdev_get_index(i);
+        *replayed = fs_disk_mount(dev);
+        if (*replayed >= 0) {
+            return dev;
+        }
+    }
+    return NULL;
+}
+
 // Only define kernel_main for actual kernel compilation
-void kernel_main(void) {
+void kernel_main(uint32_t magic, multiboot_info_t* mbi) {
     // Initialize kernel components
+    bool framebuffer = use_boot_framebuffer(magic, mbi);
     console_init();
     memory_init();
     keyboard_init();
     system_init();
+    int serial_found = serial_init();
+    unsigned outputs = console_outputs_from_cmdline(magic, mbi);
+    if (!framebuffer && magic == MULTIBOOT_BOOTLOADER_MAGIC && (mbi->flags & MULTIBOOT_INFO_FRAMEBUFFER) &&
+        mbi->framebuffer_type != MULTIBOOT_FRAMEBUFFER_TYPE_TEXT) {
+        // A graphics mode we cannot draw in hides text memory: keep COM1
+        outputs |= CONSOLE_OUTPUT_SERIAL;
+    }
+    console_set_outputs(outputs);
     
     // Display welcome message
     console_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
@@ -23,12 +101,44 @@ void kernel_main(void) {
     printf("Version 1.0.0 | AlphaKernel | Build 2025\n");
     printf("Built with standard GCC for educational purposes\n\n");
     
+    // Probe buses and disks
+    int pci_devices = pci_init();
+    int ata_disks = ata_init();
+    int virtio_disks = virtio_blk_init();
+    bcache_init();
+    console_set_color(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
+    printf("[OK] ");
+    console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    printf("Found %d PCI device(s), %d ATA and %d virtio disk(s)\n", pci_devices, ata_disks, virtio_disks);
+    if (framebuffer) {
+        console_set_color(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
+        printf("[OK] ");
+        console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+        printf("Console on a %ux%u framebuffer\n", mbi->framebuffer_width, mbi->framebuffer_height);
+    }
+    if (serial_found == 0) {
+        console_set_color(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
+        printf("[OK] ");
+        console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+        printf("COM1 serial port ready at 115200 baud\n");
+    }
+    
     // Initialize file system
     console_set_color(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
     printf("[OK] ");
     console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
-    printf("Initializing Alpha File System...\n");
-    fs_init();
+    int replayed = 0;
+    block_device_t* root_disk = mount_root_disk(&replayed);
+    if (root_disk) {
+        printf("Mounted Alpha file system from %s (%u entries, %d journal transaction(s) replayed)\n",
+               root_disk->name, fs_get_instance()->num_entries, replayed);
+    } else if (load_boot_image(magic, mbi)) {
+        printf("Mounted prebuilt filesystem image (%u entries)\n", fs_get_instance()->num_entries);
+    } else {
+        printf("Initializing Alpha File System...\n");
+        fs_init();
+    }
+    vfs_init();
     
     // Initialize shell
     console_set_color(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
@@ -16,6 +16,10 @@ void memory_get_stats(size_t* total, size_t* used, size_t* free) {
     if (free) *free = HEAP_SIZE;
 }
 
+void memory_get_counters(memory_counters_t* counters) {
+    memset(counters, 0, sizeof(memory_counters_t));
+}
+
 bool memory_check_integrity(void) {
     return true; // Assume system malloc is working
 }
@@ -28,6 +32,7 @@ static uint8_t heap[HEAP_SIZE] __attribute__((aligned(16)));
 static block_header_t* heap_start = NULL;
 static size_t total_memory = HEAP_SIZE;
 static size_t free_memory = HEAP_SIZE;
+static memory_counters_t counters;
 
 void memory_init(void) {
     // Initialize the heap with a single free block
@@ -98,12 +103,14 @@ void* malloc(size_t size) {
     
     block_header_t* block = find_free_block(size);
     if (!block) {
+        counters.failed++;
         return NULL; // Out of memory
     }
     
     split_block(block, size);
     block->is_free = 0;
     free_memory -= block->size;
+    counters.allocations++;
     
     return (void*)((uint8_t*)block + sizeof(block_header_t));
 }
@@ -121,6 +128,7 @@ void free(void* ptr) {
     
     block->is_free = 1;
     free_memory += block->size;
+    counters.frees++;
     
     merge_free_blocks();
 }
@@ -165,6 +173,10 @@ void* calloc(size_t nmemb, size_t size) {
     return ptr;
 }
 
+void memory_get_counters(memory_counters_t* out) {
+    *out = counters;
+}
+
 void memory_get_stats(size_t* total, size_t* used, size_t* free) {
     if (total) *total = total_memory;
     if (used) *used = total_memory - free_memory;
@@ -0,0 +1,142 @@
+#include "../include/kernel/pci.h"
+#include "../include/kernel/system.h"
+
+static pci_device_t devices[PCI_MAX_DEVICES];
+static int num_devices = 0;
+
+#ifdef TEST_MODE
+// Test mode - there is no PCI bus to scan
+
+int pci_init(void) {
+    return 0;
+}
+
+#else
+// Kernel mode - configuration mechanism #1 through ports 0xCF8/0xCFC
+
+#define PCI_CONFIG_ADDRESS 0xCF8
+#define PCI_CONFIG_DATA    0xCFC
+
+static void pci_select(pci_address_t addr, uint8_t offset) {
+    outl(PCI_CONFIG_ADDRESS, 0x80000000 |
+         ((uint32_t)addr.bus << 16) |
+         ((uint32_t)addr.device << 11) |
+         ((uint32_t)addr.function << 8) |
+         (offset & 0xFC));
+}
+
+uint32_t pci_config_read32(pci_address_t addr, uint8_t offset) {
+    pci_select(addr, offset);
+    return inl(PCI_CONFIG_DATA);
+}
+
+uint16_t pci_config_read16(pci_address_t addr, uint8_t offset) {
+    return (pci_config_read32(addr, offset) >> ((offset & 2) * 8)) & 0xFFFF;
+}
+
+uint8_t pci_config_read8(pci_address_t addr, uint8_t offset) {
+    return (pci_config_read32(addr, offset) >> ((offset & 3) * 8)) & 0xFF;
+}
+
+void pci_config_write32(pci_address_t addr, uint8_t offset, uint32_t value) {
+    pci_select(addr, offset);
+    outl(PCI_CONFIG_DATA, value);
+}
+
+void pci_config_write16(pci_address_t addr, uint8_t offset, uint16_t value) {
+    pci_select(addr, offset);
+    outw(PCI_CONFIG_DATA + (offset & 2), value);
+}
+
+// Probe one function and record it if present
+static void pci_record(pci_address_t addr) {
+    if (num_devices >= PCI_MAX_DEVICES) {
+        return;
+    }
+    
+    uint32_t id = pci_config_read32(addr, PCI_VENDOR_ID);
+    uint32_t class_rev = pci_config_read32(addr, PCI_CLASS_REVISION);
+    
+    pci_device_t* dev = &devices[num_devices++];
+    dev->addr = addr;
+    dev->vendor_id = id & 0xFFFF;
+    dev->device_id = id >> 16;
+    dev->class_code = class_rev >> 24;
+    dev->subclass = (class_rev >> 16) & 0xFF;
+    dev->prog_if = (class_rev >> 8) & 0xFF;
+    dev->irq_line = pci_config_read8(addr, PCI_INTERRUPT_LINE);
+}
+
+int pci_init(void) {
+    num_devices = 0;
+    
+    for (uint32_t bus = 0; bus < 256; bus++) {
+        for (uint8_t device = 0; device < 32; device++) {
+            pci_address_t addr = { bus, device, 0 };
+            if (pci_config_read16(addr, PCI_VENDOR_ID) == 0xFFFF) {
+                continue; // Empty slot
+            }
+            pci_record(addr);
+            
+            // Only multi-function devices decode functions 1-7
+            if (!(pci_config_read8(addr, PCI_HEADER_TYPE) & 0x80)) {
+                continue;
+            }
+            for (addr.function = 1; addr.function < 8; addr.function++) {
+                if (pci_config_read16(addr, PCI_VENDOR_ID) != 0xFFFF) {
+                    pci_record(addr);
+                }
+            }
+        }
+    }
+    
+    return num_devices;
+}
+
+void pci_enable_bus_master(pci_address_t addr) {
+    uint16_t command = pci_config_read16(addr, PCI_COMMAND);
+    pci_config_write16(addr, PCI_COMMAND, command | PCI_COMMAND_IO | PCI_COMMAND_BUS_MASTER);
+}
+
+#endif
+
+int pci_device_count(void) {
+    return num_devices;
+}
+
+const pci_device_t* pci_get_device(int index) {
+    if (index < 0 || index >= num_devices) {
+        return NULL;
+    }
+    return &devices[index];
+}
+
+const pci_device_t* pci_find_class(uint8_t class_code, uint8_t subclass) {
+    for (int i = 0; i < num_devices; i++) {
+        if (devices[i].class_code == class_code && devices[i].subclass == subclass) {
+            return &devices[i];
+        }
+    }
+    return NULL;
+}
+
+const pci_device_t* pci_find_device(uint16_t vendor_id, uint16_t device_id) {
+    for (int i = 0; i < num_devices; i++) {
+        if (devices[i].vendor_id == vendor_id && devices[i].device_id == device_id) {
+            return &devices[i];
+        }
+    }
+    return NULL;
+}
+
+const char* pci_class_name(uint8_t class_code) {
+    static const char* names[] = {
+        "Unclassified", "Storage", "Network", "Display", "Multimedia",
+        "Memory", "Bridge", "Communication", "System", "Input",
+        "Docking", "Processor", "Serial bus"
+    };
+    if (class_code < sizeof(names) / sizeof(names[0])) {
+        return names[class_code];
+    }
+    return "Other";
+}
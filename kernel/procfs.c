@@ -0,0 +1,208 @@
+#include "../include/kernel/vfs.h"
+#include "../include/kernel/interrupts.h"
+#include "../include/kernel/memory.h"
+#include "../include/kernel/shell.h"
+#include "../include/kernel/system.h"
+#include "../include/libc/stdio.h"
+#include "../include/libc/string.h"
+
+// procfs: read-only files generated from live kernel state when read.
+// Nothing is kept between reads, so an unread file costs nothing.
+
+#define PROCFS_FILE_SIZE 4096   // Upper bound on what one generator writes
+
+// Output cursor for a generator; text past the end is dropped
+typedef struct {
+    char* buffer;
+    size_t size;
+    size_t length;
+} proc_output_t;
+
+static void emit(proc_output_t* out, const char* format, ...) {
+    char line[1024]; // vsprintf writes at most 1023 characters
+    va_list args;
+    va_start(args, format);
+    int n = vsprintf(line, format, args);
+    va_end(args);
+
+    if (n > 0 && out->length < out->size) {
+        size_t copy = (size_t)n < out->size - out->length ? (size_t)n : out->size - out->length;
+        memcpy(out->buffer + out->length, line, copy);
+        out->length += copy;
+    }
+}
+
+static void gen_mounts(proc_output_t* out) {
+    for (int i = 0; i < vfs_mount_count(); i++) {
+        const vfs_mount_t* mnt = vfs_get_mount(i);
+        emit(out, "%s %s %s %s 0 0\n", mnt->source, mnt->path, mnt->ops->name,
+             mnt->ops->write ? "rw" : "ro");
+    }
+}
+
+static void gen_meminfo(proc_output_t* out) {
+    size_t total, used, free;
+    memory_counters_t counters;
+    memory_get_stats(&total, &used, &free);
+    memory_get_counters(&counters);
+
+    emit(out, "HeapTotal: %u kB\n", (uint32_t)(total / 1024));
+    emit(out, "HeapUsed: %u kB\n", (uint32_t)(used / 1024));
+    emit(out, "HeapFree: %u kB\n", (uint32_t)(free / 1024));
+    emit(out, "Allocations: %u\n", counters.allocations);
+    emit(out, "Frees: %u\n", counters.frees);
+    emit(out, "FailedAllocations: %u\n", counters.failed);
+}
+
+static void gen_fsstats(proc_output_t* out) {
+    uint32_t files, used, free, logical, physical;
+    fs_counters_t counters;
+    fs_get_stats(&files, &used, &free);
+    fs_get_dedup_stats(&logical, &physical);
+    fs_get_counters(&counters);
+
+    emit(out, "Entries: %u\n", files);
+    emit(out, "DataUsed: %u\n", used);
+    emit(out, "DataFree: %u\n", free);
+    emit(out, "DataReferenced: %u\n", logical);
+    emit(out, "DedupSaved: %u\n", logical - physical);
+    emit(out, "Reads: %u\n", counters.reads);
+    emit(out, "BytesRead: %u\n", counters.bytes_read);
+    emit(out, "Writes: %u\n", counters.writes);
+    emit(out, "BytesWritten: %u\n", counters.bytes_written);
+    emit(out, "Creates: %u\n", counters.creates);
+    emit(out, "Deletes: %u\n", counters.deletes);
+}
+
+static void gen_interrupts(proc_output_t* out) {
+    static const char* names[IRQ_COUNT] = {
+        [IRQ_TIMER] = "timer", [IRQ_KEYBOARD] = "keyboard", [IRQ_CASCADE] = "cascade",
+        [IRQ_COM1] = "com1", [IRQ_ATA_PRIMARY] = "ata0", [IRQ_ATA_SECONDARY] = "ata1",
+    };
+
+    // Lines that never fired are left out
+    for (uint8_t irq = 0; irq < IRQ_COUNT; irq++) {
+        uint32_t count = irq_get_count(irq);
+        if (count > 0) {
+            emit(out, "%u: %u %s\n", irq, count, names[irq] ? names[irq] : "-");
+        }
+    }
+}
+
+static void gen_uptime(proc_output_t* out) {
+    uint32_t ticks = system_get_uptime();
+    uint32_t hundredths = (ticks % SYSTEM_TIMER_HZ) * 100 / SYSTEM_TIMER_HZ;
+    emit(out, "%u.%u%u %u\n", ticks / SYSTEM_TIMER_HZ, hundredths / 10, hundredths % 10, ticks);
+}
+
+static void gen_cmdstats(proc_output_t* out) {
+    // Commands that were never run are left out
+    for (int i = 0; i < shell_get_command_count(); i++) {
+        const shell_command_t* cmd = shell_get_command(i);
+        if (cmd->calls > 0) {
+            emit(out, "%s %u %u\n", cmd->name, cmd->calls, cmd->ticks);
+        }
+    }
+    emit(out, "unknown %u 0\n", shell_get_unknown_count());
+}
+
+static const struct {
+    const char* name;
+    void (*generate)(proc_output_t* out);
+} proc_files[] = {
+    { "cmdstats", gen_cmdstats },
+    { "fsstats", gen_fsstats },
+    { "interrupts", gen_interrupts },
+    { "meminfo", gen_meminfo },
+    { "mounts", gen_mounts },
+    { "uptime", gen_uptime },
+};
+
+#define NUM_PROC_FILES (sizeof(proc_files) / sizeof(proc_files[0]))
+
+static int find_file(const char* path) {
+    for (uint32_t i = 0; i < NUM_PROC_FILES; i++) {
+        if (strcmp(proc_files[i].name, path + 1) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int procfs_read(vfs_mount_t* mnt, const char* path, uint32_t offset, void* buffer, size_t size) {
+    (void)mnt;
+    if (strcmp(path, "/") == 0) {
+        return VFS_EISDIR;
+    }
+    int index = find_file(path);
+    if (index < 0) {
+        return VFS_ENOENT;
+    }
+
+    // A whole-file read is generated straight into the caller's buffer;
+    // only partial reads need the scratch copy
+    if (offset == 0 && size >= PROCFS_FILE_SIZE) {
+        proc_output_t out = { (char*)buffer, size, 0 };
+        proc_files[index].generate(&out);
+        return out.length;
+    }
+
+    static char scratch[PROCFS_FILE_SIZE];
+    proc_output_t out = { scratch, sizeof(scratch), 0 };
+    proc_files[index].generate(&out);
+    if (offset >= out.length) {
+        return 0;
+    }
+    if (size > out.length - offset) {
+        size = out.length - offset;
+    }
+    memcpy(buffer, scratch + offset, size);
+    return size;
+}
+
+static int procfs_stat(vfs_mount_t* mnt, const char* path, vfs_stat_t* st) {
+    (void)mnt;
+    memset(st, 0, sizeof(vfs_stat_t));
+    if (strcmp(path, "/") == 0) {
+        st->is_directory = true;
+        st->permissions = 0555;
+        return 0;
+    }
+    if (find_file(path) < 0) {
+        return VFS_ENOENT;
+    }
+    st->permissions = 0444; // Size is only known once generated, like Linux
+    return 0;
+}
+
+static int procfs_list(vfs_mount_t* mnt, const char* path, char* buffer, size_t size) {
+    (void)mnt;
+    if (strcmp(path, "/") != 0) {
+        return VFS_ENOENT;
+    }
+
+    size_t offset = 0;
+    for (uint32_t i = 0; i < NUM_PROC_FILES; i++) {
+        size_t len = strlen(proc_files[i].name);
+        if (offset + len + 2 > size) {
+            break;
+        }
+        strcpy(buffer + offset, proc_files[i].name);
+        offset += len;
+        buffer[offset++] = '\n';
+    }
+
+    if (offset > 0) {
+        buffer[offset - 1] = '\0';
+    } else {
+        buffer[0] = '\0';
+    }
+    return offset;
+}
+
+const vfs_ops_t procfs_ops = {
+    .name = "proc",
+    .stat = procfs_stat,
+    .read = procfs_read,
+    .list = procfs_list,
+};
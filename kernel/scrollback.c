@@ -0,0 +1,84 @@
+#include "../include/kernel/scrollback.h"
+
+#define SCROLLBACK_RECORD_MAX (2 + 1 + 3 * SCROLLBACK_MAX_WIDTH + 2)
+
+// Byte distance bytes behind the head (1 is the newest)
+static inline uint8_t scrollback_byte(const scrollback_t* sb, uint32_t distance) {
+    return sb->ring[(sb->head + CONSOLE_SCROLLBACK_SIZE - distance) % CONSOLE_SCROLLBACK_SIZE];
+}
+
+// Record size whose low byte is distance bytes behind the head
+static inline uint32_t scrollback_size(const scrollback_t* sb, uint32_t distance) {
+    return scrollback_byte(sb, distance) | (uint32_t)scrollback_byte(sb, distance - 1) << 8;
+}
+
+void scrollback_init(scrollback_t* sb) {
+    sb->head = 0;
+    sb->used = 0;
+    sb->lines = 0;
+}
+
+void scrollback_append(scrollback_t* sb, const uint16_t* row, size_t width) {
+    uint8_t record[SCROLLBACK_RECORD_MAX];
+    size_t length = width;
+    while (length > 0 && row[length - 1] == SCROLLBACK_BLANK) {
+        length--;
+    }
+
+    size_t n = 3;
+    record[2] = length;
+    for (size_t x = 0; x < length; ) {
+        size_t run = 1;
+        while (x + run < length && (row[x + run] >> 8) == (row[x] >> 8)) {
+            run++;
+        }
+        record[n++] = run;
+        record[n++] = row[x] >> 8;
+        x += run;
+    }
+    for (size_t x = 0; x < length; x++) {
+        record[n++] = row[x] & 0xFF;
+    }
+    n += 2;
+    record[0] = record[n - 2] = n & 0xFF;
+    record[1] = record[n - 1] = n >> 8;
+
+    // Evict the oldest records, whose size leads them
+    while (CONSOLE_SCROLLBACK_SIZE - sb->used < n) {
+        sb->used -= scrollback_size(sb, sb->used);
+        sb->lines--;
+    }
+    for (size_t i = 0; i < n; i++) {
+        sb->ring[(sb->head + i) % CONSOLE_SCROLLBACK_SIZE] = record[i];
+    }
+    sb->head = (sb->head + n) % CONSOLE_SCROLLBACK_SIZE;
+    sb->used += n;
+    sb->lines++;
+}
+
+void scrollback_decode(const scrollback_t* sb, uint32_t back, uint16_t* row, size_t width) {
+    // Records are walked by distance from the head, so offset k into a
+    // record starting start bytes back is at distance start - k
+    uint32_t start = 0;
+    for (uint32_t i = 0; i <= back; i++) {
+        start += scrollback_size(sb, start + 2);
+    }
+
+    size_t length = scrollback_byte(sb, start - 2);
+    uint32_t runs = 3;
+    uint32_t text = runs;
+    for (size_t covered = 0; covered < length; text += 2) {
+        covered += scrollback_byte(sb, start - text);
+    }
+
+    size_t x = 0;
+    for (; x < length; runs += 2) {
+        uint8_t attribute = scrollback_byte(sb, start - runs - 1);
+        for (size_t end = x + scrollback_byte(sb, start - runs); x < end; x++) {
+            row[x] = scrollback_byte(sb, start - text - x) | (uint16_t)attribute << 8;
+        }
+    }
+    for (; x < width; x++) {
+        row[x] = SCROLLBACK_BLANK;
+    }
+}
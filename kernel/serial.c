@@ -0,0 +1,206 @@
+#include "../include/kernel/serial.h"
+#include "../include/kernel/interrupts.h"
+#include "../include/kernel/system.h"
+
+#ifndef TEST_MODE
+// Kernel mode only - 16550 UART on COM1
+
+#define COM1_BASE 0x3F8
+
+// Register offsets from the port base
+#define UART_DATA 0   // RBR/THR, or divisor low byte with DLAB set
+#define UART_IER  1   // Interrupt enable, or divisor high byte with DLAB set
+#define UART_IIR  2   // Interrupt identification (read)
+#define UART_FCR  2   // FIFO control (write)
+#define UART_LCR  3
+#define UART_MCR  4
+#define UART_LSR  5
+#define UART_MSR  6
+
+#define UART_IER_RX_DATA   0x01
+#define UART_IER_TX_EMPTY  0x02
+#define UART_IIR_NONE      0x01  // No interrupt pending
+#define UART_IIR_ID_MASK   0x0E
+#define UART_IIR_MODEM     0x00
+#define UART_IIR_TX_EMPTY  0x02
+#define UART_IIR_RX_DATA   0x04
+#define UART_IIR_LINE      0x06
+#define UART_IIR_RX_TIMEOUT 0x0C
+#define UART_IIR_FIFO      0xC0  // Both set on a working 16550A FIFO
+#define UART_FCR_ENABLE    0xC7  // Enable, clear both FIFOs, RX trigger at 14 bytes
+#define UART_LCR_DLAB      0x80
+#define UART_LCR_8N1       0x03
+#define UART_MCR_RUN       0x0B  // DTR, RTS and OUT2 (gates the IRQ line)
+#define UART_MCR_LOOPBACK  0x1E
+#define UART_LSR_DATA      0x01
+#define UART_LSR_TX_EMPTY  0x20  // THR (and FIFO) empty
+
+#define UART_BAUD_DIVISOR  1     // 115200 baud
+#define UART_FIFO_SIZE     16
+#define UART_PROBE_BYTE    0xAE
+
+// Single producer, single consumer rings with free-running indices. Kernel
+// code fills the transmit ring and empties the receive ring; the IRQ handler
+// does the reverse, so each index has one writer and neither side locks.
+// Transmit draining outside the handler runs with interrupts off, which
+// keeps it the only consumer while it does.
+static char tx_buffer[SERIAL_TX_BUFFER_SIZE];
+static volatile uint32_t tx_head;
+static volatile uint32_t tx_tail;
+static char rx_buffer[SERIAL_RX_BUFFER_SIZE];
+static volatile uint32_t rx_head;
+static volatile uint32_t rx_tail;
+
+static bool uart_present = false;
+static uint32_t tx_burst = 1;    // Bytes the transmitter takes once THR is empty
+
+// Keep ring stores on their side of the index update that publishes them
+static inline void compiler_barrier(void) {
+    __asm__ volatile ("" : : : "memory");
+}
+
+// Refill the transmitter once it has emptied. Interrupts must be off.
+static void serial_tx_fill(void) {
+    if (!(inb(COM1_BASE + UART_LSR) & UART_LSR_TX_EMPTY)) {
+        return; // Still sending; the empty interrupt will call back
+    }
+    uint32_t tail = tx_tail;
+    uint32_t count = tx_head - tail;
+    if (count > tx_burst) {
+        count = tx_burst;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        outb(COM1_BASE + UART_DATA, tx_buffer[(tail + i) & (SERIAL_TX_BUFFER_SIZE - 1)]);
+    }
+    compiler_barrier();
+    tx_tail = tail + count;
+}
+
+static void serial_rx_drain(void) {
+    while (inb(COM1_BASE + UART_LSR) & UART_LSR_DATA) {
+        char c = inb(COM1_BASE + UART_DATA);
+        uint32_t head = rx_head;
+        if (head - rx_tail < SERIAL_RX_BUFFER_SIZE) {
+            rx_buffer[head & (SERIAL_RX_BUFFER_SIZE - 1)] = c;
+            compiler_barrier();
+            rx_head = head + 1;
+        }
+    }
+}
+
+static void serial_irq(interrupt_frame_t* frame) {
+    (void)frame;
+    uint8_t iir;
+    while (!((iir = inb(COM1_BASE + UART_IIR)) & UART_IIR_NONE)) {
+        switch (iir & UART_IIR_ID_MASK) {
+        case UART_IIR_RX_DATA:
+        case UART_IIR_RX_TIMEOUT:
+            serial_rx_drain();
+            break;
+        case UART_IIR_TX_EMPTY:
+            serial_tx_fill();
+            break;
+        case UART_IIR_LINE:
+            inb(COM1_BASE + UART_LSR);
+            break;
+        default:
+            inb(COM1_BASE + UART_MSR);
+            break;
+        }
+    }
+}
+
+int serial_init(void) {
+    uint16_t port = COM1_BASE;
+    outb(port + UART_IER, 0);
+    outb(port + UART_LCR, UART_LCR_DLAB);
+    outb(port + UART_DATA, UART_BAUD_DIVISOR & 0xFF);
+    outb(port + UART_IER, UART_BAUD_DIVISOR >> 8);
+    outb(port + UART_LCR, UART_LCR_8N1);
+    outb(port + UART_FCR, UART_FCR_ENABLE);
+
+    // A byte sent in loopback mode comes straight back if a UART is there
+    outb(port + UART_MCR, UART_MCR_LOOPBACK);
+    outb(port + UART_DATA, UART_PROBE_BYTE);
+    if (inb(port + UART_DATA) != UART_PROBE_BYTE) {
+        return -1;
+    }
+    outb(port + UART_MCR, UART_MCR_RUN);
+
+    // 8250s and 16450s have no FIFO and take one byte at a time
+    if ((inb(port + UART_IIR) & UART_IIR_FIFO) == UART_IIR_FIFO) {
+        tx_burst = UART_FIFO_SIZE;
+    }
+
+    tx_head = tx_tail = 0;
+    rx_head = rx_tail = 0;
+    uart_present = true;
+    irq_register_handler(IRQ_COM1, serial_irq);
+    outb(port + UART_IER, UART_IER_RX_DATA | UART_IER_TX_EMPTY);
+    return 0;
+}
+
+bool serial_present(void) {
+    return uart_present;
+}
+
+void serial_write(const char* data, size_t size) {
+    if (!uart_present) {
+        return;
+    }
+
+    while (size > 0) {
+        uint32_t head = tx_head;
+        uint32_t space = SERIAL_TX_BUFFER_SIZE - (head - tx_tail);
+        if (space == 0) {
+            // Full: wait for the transmitter here rather than for the IRQ,
+            // which never comes while interrupts are off
+            bool enabled = irq_save();
+            while (!(inb(COM1_BASE + UART_LSR) & UART_LSR_TX_EMPTY)) {
+            }
+            serial_tx_fill();
+            irq_restore(enabled);
+            continue;
+        }
+
+        uint32_t count = size < space ? size : space;
+        for (uint32_t i = 0; i < count; i++) {
+            tx_buffer[(head + i) & (SERIAL_TX_BUFFER_SIZE - 1)] = data[i];
+        }
+        compiler_barrier();
+        tx_head = head + count;
+        data += count;
+        size -= count;
+    }
+
+    // The empty interrupt only fires on a transition, so an idle
+    // transmitter has to be started by hand
+    bool enabled = irq_save();
+    serial_tx_fill();
+    irq_restore(enabled);
+}
+
+void serial_flush(void) {
+    if (!uart_present) {
+        return;
+    }
+
+    bool enabled = irq_save();
+    while (tx_head != tx_tail) {
+        serial_tx_fill();
+    }
+    irq_restore(enabled);
+}
+
+int serial_read(void) {
+    uint32_t tail = rx_tail;
+    if (tail == rx_head) {
+        return -1;
+    }
+    char c = rx_buffer[tail & (SERIAL_RX_BUFFER_SIZE - 1)];
+    compiler_barrier();
+    rx_tail = tail + 1;
+    return (unsigned char)c;
+}
+
+#endif
@@ -1,14 +1,25 @@
 #include "../include/kernel/shell.h"
+#include "../include/kernel/bcache.h"
+#include "../include/kernel/blockdev.h"
+#include "../include/kernel/fat32.h"
 #include "../include/kernel/fs.h"
+#include "../include/kernel/fs_disk.h"
+#include "../include/kernel/journal.h"
 #include "../include/kernel/keyboard.h"
 #include "../include/kernel/console.h"
 #include "../include/kernel/memory.h"
+#include "../include/kernel/pci.h"
+#include "../include/kernel/system.h"
+#include "../include/kernel/vfs.h"
 #include "../include/libc/stdio.h"
 #include "../include/libc/stdlib.h"
 #include "../include/libc/string.h"
 
 #define MAX_COMMANDS 64
 
+// Blocks the compactor may move each time the shell is idle
+#define COMPACT_IDLE_MOVES 4
+
 static shell_command_t commands[MAX_COMMANDS];
 static int num_commands = 0;
 static char current_dir[SHELL_MAX_PATH_LENGTH] = "/";
@@ -17,6 +28,7 @@ static int history_count = 0;
 static char username[32] = "user";
 static char hostname[32] = "alphaos";
 static bool is_root = false;
+static uint32_t unknown_commands = 0;
 
 // Forward declarations of built-in commands
 static void cmd_help(int argc, char* argv[]);
@@ -33,6 +45,9 @@ static void cmd_stat(int argc, char* argv[]);
 static void cmd_mem(int argc, char* argv[]);
 static void cmd_history(int argc, char* argv[]);
 static void cmd_tree(int argc, char* argv[]);
+static void cmd_du(int argc, char* argv[]);
+static void cmd_find(int argc, char* argv[]);
+static void cmd_grep(int argc, char* argv[]);
 static void cmd_info(int argc, char* argv[]);
 static void cmd_whoami(int argc, char* argv[]);
 static void cmd_hostname(int argc, char* argv[]);
@@ -43,23 +58,40 @@ static void cmd_banner(int argc, char* argv[]);
 static void cmd_su(int argc, char* argv[]);
 static void cmd_root_shell(int argc, char* argv[]);
 static void cmd_exit_root(int argc, char* argv[]);
+static void cmd_sync(int argc, char* argv[]);
+static void cmd_lsblk(int argc, char* argv[]);
+static void cmd_lspci(int argc, char* argv[]);
+static void cmd_mkfs(int argc, char* argv[]);
+static void cmd_mount(int argc, char* argv[]);
+static void cmd_chattr(int argc, char* argv[]);
+static void cmd_snapshot(int argc, char* argv[]);
+
+// Runs while the shell waits for a key
+static void shell_idle(void) {
+    if (fs_compact_step(COMPACT_IDLE_MOVES) > 0) {
+        fs_commit();
+    }
+}
 
 void shell_init(void) {
     // Register built-in commands with usage information
     shell_register_command("help", cmd_help, "Display help information", "help [command]");
     shell_register_command("ls", cmd_ls, "List directory contents", "ls [-l] [directory]");
     shell_register_command("cd", cmd_cd, "Change directory", "cd <directory>");
-    shell_register_command("cat", cmd_cat, "Display file contents", "cat <filename>");
+    shell_register_command("cat", cmd_cat, "Display file contents", "cat <filename>...");
     shell_register_command("echo", cmd_echo, "Display a line of text", "echo <text>");
     shell_register_command("mkdir", cmd_mkdir, "Create a directory", "mkdir <directory>");
     shell_register_command("touch", cmd_touch, "Create a file", "touch <filename>");
-    shell_register_command("rm", cmd_rm, "Remove a file or directory", "rm <filename>");
+    shell_register_command("rm", cmd_rm, "Remove files or directories", "rm <filename>...");
     shell_register_command("clear", cmd_clear, "Clear the screen", "clear");
     shell_register_command("pwd", cmd_pwd, "Print working directory", "pwd");
     shell_register_command("stat", cmd_stat, "Display file system statistics", "stat");
     shell_register_command("mem", cmd_mem, "Display memory statistics", "mem");
     shell_register_command("history", cmd_history, "Show command history", "history");
-    shell_register_command("tree", cmd_tree, "Show directory tree", "tree [directory]");
+    shell_register_command("tree", cmd_tree, "Show directory tree", "tree [directory] - stays on one file system");
+    shell_register_command("du", cmd_du, "Show space used beneath a directory", "du [-s] [directory] - stays on one file system");
+    shell_register_command("find", cmd_find, "Find files by name", "find [directory] [-name pattern] - stays on one file system");
+    shell_register_command("grep", cmd_grep, "Print lines containing text", "grep [-r] [-n] <text> <path>... - -r stays on one file system");
     shell_register_command("info", cmd_info, "Show system information", "info");
     shell_register_command("whoami", cmd_whoami, "Display current user", "whoami");
     shell_register_command("hostname", cmd_hostname, "Display or set hostname", "hostname [name]");
@@ -70,6 +102,16 @@ void shell_init(void) {
     shell_register_command("su", cmd_su, "Switch user", "su [username]");
     shell_register_command("root", cmd_root_shell, "Enter root shell", "root");
     shell_register_command("exit", cmd_exit_root, "Exit root shell", "exit");
+    shell_register_command("sync", cmd_sync, "Flush file system to backing store", "sync");
+    shell_register_command("lsblk", cmd_lsblk, "List block devices", "lsblk");
+    shell_register_command("lspci", cmd_lspci, "List PCI devices", "lspci");
+    shell_register_command("mkfs", cmd_mkfs, "Store the file system on a disk", "mkfs <device>");
+    shell_register_command("mount", cmd_mount, "List mounts or mount a FAT32 disk read-only", "mount [device path]");
+    shell_register_command("chattr", cmd_chattr, "Turn transparent compression on or off", "chattr +c|-c <path>");
+    shell_register_command("snapshot", cmd_snapshot, "List, take, restore or delete file system snapshots",
+                           "snapshot [create | restore <id> | delete <id>]");
+    
+    keyboard_set_idle_handler(shell_idle);
     
     // Display welcome banner
     cmd_banner(0, NULL);
@@ -91,9 +133,23 @@ void shell_register_command(const char* name, command_handler_t handler, const c
     commands[num_commands].handler = handler;
     commands[num_commands].help = strdup(help);
     commands[num_commands].usage = strdup(usage);
+    commands[num_commands].calls = 0;
+    commands[num_commands].ticks = 0;
     num_commands++;
 }
 
+int shell_get_command_count(void) {
+    return num_commands;
+}
+
+const shell_command_t* shell_get_command(int index) {
+    return (index >= 0 && index < num_commands) ? &commands[index] : NULL;
+}
+
+uint32_t shell_get_unknown_count(void) {
+    return unknown_commands;
+}
+
 void shell_print_enhanced_prompt(void) {
     // Get short directory name
     const char* short_dir = current_dir;
@@ -102,33 +158,11 @@ void shell_print_enhanced_prompt(void) {
         short_dir = current_dir + strlen(current_dir) - 17;
     }
     
-    // Color-coded prompt: user@hostname:dir$
-    if (is_root) {
-        console_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);  // Red for root like Linux
-    } else {
-        console_set_color(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
-    }
-    printf("%s", username);
-    
-    console_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
-    printf("@");
-    console_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
-    printf("%s", hostname);
-    console_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
-    printf(":");
-    console_set_color(VGA_COLOR_LIGHT_BLUE, VGA_COLOR_BLACK);
-    printf("%s", short_dir);
-    console_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
-    
-    // Different prompt for root vs user - Linux style
-    if (is_root) {
-        console_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
-        printf("# ");
-    } else {
-        console_set_color(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
-        printf("$ ");
-    }
-    console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    // Color-coded prompt: user@hostname:dir$, red with '#' for root like Linux
+    const char* accent = is_root ? CONSOLE_LIGHT_RED : CONSOLE_LIGHT_GREEN;
+    printf("%s%s" CONSOLE_WHITE "@" CONSOLE_LIGHT_CYAN "%s" CONSOLE_WHITE ":"
+           CONSOLE_LIGHT_BLUE "%s%s%s " CONSOLE_RESET,
+           accent, username, hostname, short_dir, accent, is_root ? "#" : "$");
 }
 
 void shell_print_prompt(void) {
@@ -165,6 +199,90 @@ int shell_get_history_count(void) {
     return history_count < SHELL_HISTORY_SIZE ? history_count : SHELL_HISTORY_SIZE;
 }
 
+// Shell-style wildcard match: '*' is any run of characters, '?' any one
+static bool glob_match(const char* pattern, const char* name) {
+    while (*pattern) {
+        if (*pattern == '*') {
+            pattern++;
+            for (const char* rest = name; ; rest++) {
+                if (glob_match(pattern, rest)) {
+                    return true;
+                }
+                if (*rest == '\0') {
+                    return false;
+                }
+            }
+        }
+        if (*name == '\0' || (*pattern != '?' && *pattern != *name)) {
+            return false;
+        }
+        pattern++;
+        name++;
+    }
+    return *name == '\0';
+}
+
+// Replace arguments with '*' or '?' in their last component by the names
+// they match, in directory order (sorted on the ramfs). A pattern that
+// matches nothing is passed on unchanged. Returns the new argc.
+static int expand_globs(int argc, char* argv[]) {
+    static char names[SHELL_MAX_COMMAND_LENGTH * 4]; // The expanded arguments
+    static char listing[FS_MAX_FILES * FS_MAX_FILENAME_LENGTH];
+    char* expanded[SHELL_MAX_ARGS];
+    int count = 0;
+    size_t used = 0;
+    
+    for (int i = 0; i < argc; i++) {
+        const char* slash = strrchr(argv[i], '/');
+        const char* pattern = slash ? slash + 1 : argv[i];
+        if (i == 0 || (!strchr(pattern, '*') && !strchr(pattern, '?'))) {
+            if (count < SHELL_MAX_ARGS) {
+                expanded[count++] = argv[i];
+            }
+            continue;
+        }
+        
+        // Matches keep the directory part as it was typed
+        size_t dir_len = pattern - argv[i];
+        char dir[FS_MAX_FILENAME_LENGTH];
+        char path[FS_MAX_FILENAME_LENGTH];
+        if (dir_len >= sizeof(dir)) {
+            dir_len = 0;
+        }
+        memcpy(dir, argv[i], dir_len);
+        dir[dir_len] = '\0';
+        fs_get_absolute_path(dir_len ? dir : ".", current_dir, path, sizeof(path));
+        
+        int matches = 0;
+        if (vfs_list(path, listing, sizeof(listing)) >= 0) {
+            for (char* name = strtok(listing, "\n"); name; name = strtok(NULL, "\n")) {
+                size_t len = strlen(name);
+                if (len > 0 && name[len - 1] == '/') {
+                    name[--len] = '\0';
+                }
+                // Hidden names only match a pattern that starts with '.'
+                if ((name[0] == '.' && pattern[0] != '.') || !glob_match(pattern, name)) {
+                    continue;
+                }
+                if (count >= SHELL_MAX_ARGS || used + dir_len + len + 1 > sizeof(names)) {
+                    break;
+                }
+                memcpy(names + used, argv[i], dir_len);
+                strcpy(names + used + dir_len, name);
+                expanded[count++] = names + used;
+                used += dir_len + len + 1;
+                matches++;
+            }
+        }
+        if (matches == 0 && count < SHELL_MAX_ARGS) {
+            expanded[count++] = argv[i];
+        }
+    }
+    
+    memcpy(argv, expanded, count * sizeof(char*));
+    return count;
+}
+
 void shell_process_command(const char* command) {
     // Add to history
     shell_add_to_history(command);
@@ -188,14 +306,23 @@ void shell_process_command(const char* command) {
         return; // Empty command
     }
     
+    // calc takes '*' as an operator and find matches its own patterns
+    if (strcmp(argv[0], "calc") != 0 && strcmp(argv[0], "find") != 0) {
+        argc = expand_globs(argc, argv);
+    }
+    
     // Find and execute command
     for (int i = 0; i < num_commands; i++) {
         if (strcmp(argv[0], commands[i].name) == 0) {
+            uint32_t start = system_get_uptime();
             commands[i].handler(argc, argv);
+            commands[i].calls++;
+            commands[i].ticks += system_get_uptime() - start;
             return;
         }
     }
     
+    unknown_commands++;
     console_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
     printf("alphaos: command not found: %s\n", argv[0]);
     console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
@@ -206,6 +333,8 @@ void shell_run(void) {
     char command[SHELL_MAX_COMMAND_LENGTH];
     
     while (1) {
+        // Everything the last command changed goes to the log as one group
+        fs_commit();
         shell_print_prompt();
         
         // Get command from user
@@ -263,12 +392,17 @@ static void cmd_help(int argc, char* argv[]) {
     printf("  %-12s - %s\n", "cat", "Display file contents");
     printf("  %-12s - %s\n", "rm", "Remove file or directory");
     printf("  %-12s - %s\n", "tree", "Show directory tree");
+    printf("  %-12s - %s\n", "sync", "Flush file system to backing store");
+    printf("  %-12s - %s\n", "chattr", "Compress a file or new files in a directory");
+    printf("  %-12s - %s\n", "snapshot", "Save or roll back the whole file system");
     
     printf("\nSystem Commands:\n");
     printf("  %-12s - %s\n", "clear", "Clear screen");
     printf("  %-12s - %s\n", "info", "Show system information");
     printf("  %-12s - %s\n", "stat", "File system statistics");
     printf("  %-12s - %s\n", "mem", "Memory statistics");
+    printf("  %-12s - %s\n", "lsblk", "List block devices");
+    printf("  %-12s - %s\n", "lspci", "List PCI devices");
     printf("  %-12s - %s\n", "uptime", "System uptime");
     printf("  %-12s - %s\n", "date", "Current date/time");
     
@@ -358,6 +492,22 @@ static void cmd_su(int argc, char* argv[]) {
     }
 }
 
+// Same layout as fs_get_permissions_string, for any mounted file system
+static void format_permissions(const vfs_stat_t* st, char* perms, size_t size) {
+    uint32_t p = st->permissions;
+    snprintf(perms, size, "%c%c%c%c%c%c%c%c%c",
+        st->is_directory ? 'd' : '-',
+        (p & 0400) ? 'r' : '-',
+        (p & 0200) ? 'w' : '-',
+        (p & 0100) ? 'x' : '-',
+        (p & 0040) ? 'r' : '-',
+        (p & 0020) ? 'w' : '-',
+        (p & 0010) ? 'x' : '-',
+        (p & 0004) ? 'r' : '-',
+        (p & 0002) ? 'w' : '-'
+    );
+}
+
 static void cmd_ls(int argc, char* argv[]) {
     bool detailed = false;
     char* dir = current_dir;
@@ -375,11 +525,11 @@ static void cmd_ls(int argc, char* argv[]) {
     fs_get_absolute_path(dir, current_dir, absolute_path, sizeof(absolute_path));
     
     char buffer[FS_MAX_FILES * FS_MAX_FILENAME_LENGTH];
-    int result = fs_list_directory(absolute_path, buffer, sizeof(buffer));
+    int result = vfs_list(absolute_path, buffer, sizeof(buffer));
     
     if (result < 0) {
         console_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
-        printf("ls: cannot access '%s': No such directory\n", dir);
+        printf("ls: cannot access '%s': %s\n", dir, vfs_strerror(result));
         console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
         return;
     }
@@ -398,41 +548,50 @@ static void cmd_ls(int argc, char* argv[]) {
             snprintf(full_path, sizeof(full_path), "%s/%s", absolute_path, line);
             fs_normalize_path(full_path, full_path, sizeof(full_path));
             
-            char perms[16];
-            fs_get_permissions_string(full_path, perms, sizeof(perms));
-            
-            size_t size = fs_file_size(full_path);
-            const char* type = fs_get_file_type_string(full_path);
-            
-            if (strstr(line, "/")) {
-                console_set_color(VGA_COLOR_LIGHT_BLUE, VGA_COLOR_BLACK);
-            } else {
-                console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+            char perms[16] = "---------";
+            size_t size = 0;
+            vfs_stat_t st;
+            if (vfs_stat(full_path, &st) == 0) {
+                format_permissions(&st, perms, sizeof(perms));
+                size = st.size;
             }
             
-            printf("%s %8zu %s\n", perms, size, line);
+            // printf has no field widths: right-align the size by hand
+            const char* spaces = "        ";
+            char digits[12];
+            snprintf(digits, sizeof(digits), "%u", (unsigned)size);
+            size_t len = strlen(digits);
+            printf("%s %s%s %s%s" CONSOLE_RESET "\n", perms, len < 8 ? spaces + len : "", digits,
+                   strstr(line, "/") ? CONSOLE_LIGHT_BLUE : "", line);
             line = strtok(NULL, "\n");
         }
     } else {
-        // Simple listing with colors
-        char* line = strtok(buffer, "\n");
+        // Simple listing with colors, four names to a row; each row is
+        // built with its colour changes inline and written at once
+        char row[4 * (FS_MAX_FILENAME_LENGTH + 16)];
+        size_t used = 0;
         int count = 0;
+        char* line = strtok(buffer, "\n");
         while (line != NULL) {
-            if (strstr(line, "/")) {
-                console_set_color(VGA_COLOR_LIGHT_BLUE, VGA_COLOR_BLACK);
-            } else {
-                console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+            const char* color = strstr(line, "/") ? CONSOLE_LIGHT_BLUE : CONSOLE_RESET;
+            size_t len = strlen(line);
+            if (used + strlen(color) + len + 20 < sizeof(row)) {
+                strcpy(row + used, color);
+                used += strlen(color);
+                strcpy(row + used, line);
+                used += len;
+                while (len++ < 20) {
+                    row[used++] = ' ';
+                }
             }
-            
-            printf("%-20s", line);
-            count++;
-            if (count % 4 == 0) printf("\n");
-            
             line = strtok(NULL, "\n");
+            if (++count % 4 == 0 || line == NULL) {
+                row[used] = '\0';
+                printf("%s" CONSOLE_RESET "\n", row);
+                used = 0;
+            }
         }
-        if (count % 4 != 0) printf("\n");
     }
-    console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
 }
 
 static void cmd_cd(int argc, char* argv[]) {
@@ -446,37 +605,51 @@ static void cmd_cd(int argc, char* argv[]) {
         return;
     }
     
-    if (fs_change_directory(argv[1], current_dir, SHELL_MAX_PATH_LENGTH) != 0) {
-        console_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
-        printf("cd: %s: No such directory\n", argv[1]);
-        console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    char path[FS_MAX_FILENAME_LENGTH];
+    vfs_stat_t st;
+    fs_get_absolute_path(argv[1], current_dir, path, sizeof(path));
+    if (vfs_stat(path, &st) == 0 && st.is_directory) {
+        shell_set_current_dir(path);
+        return;
     }
+    
+    console_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+    printf("cd: %s: No such directory\n", argv[1]);
+    console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
 }
 
 static void cmd_cat(int argc, char* argv[]) {
     if (argc < 2) {
-        printf("Usage: cat <filename>\n");
-        return;
-    }
-    
-    char path[FS_MAX_FILENAME_LENGTH];
-    fs_get_absolute_path(argv[1], current_dir, path, sizeof(path));
-    
-    char buffer[FS_MAX_FILE_SIZE];
-    int bytes_read = fs_read_file(path, buffer, sizeof(buffer) - 1);
-    
-    if (bytes_read < 0) {
-        console_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
-        printf("cat: %s: No such file or directory\n", argv[1]);
-        console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+        printf("Usage: cat <filename>...\n");
         return;
     }
     
-    buffer[bytes_read] = '\0';
-    printf("%s", buffer);
-    
-    if (bytes_read > 0 && buffer[bytes_read - 1] != '\n') {
-        printf("\n");
+    for (int i = 1; i < argc; i++) {
+        char path[FS_MAX_FILENAME_LENGTH];
+        fs_get_absolute_path(argv[i], current_dir, path, sizeof(path));
+        
+        // Files can be far larger than the buffer: print in chunks
+        char buffer[FS_MAX_FILE_SIZE];
+        uint32_t offset = 0;
+        int n;
+        char last = '\n';
+        while ((n = vfs_read(path, offset, buffer, sizeof(buffer))) > 0) {
+            // Straight to the console: printf stops at its 1 KB buffer
+            console_write_size(buffer, n);
+            offset += n;
+            last = buffer[n - 1];
+            if (n < (int)sizeof(buffer)) {
+                break; // Short read: end of file, no need to ask again
+            }
+        }
+        
+        if (n < 0) {
+            console_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+            printf("cat: %s: %s\n", argv[i], vfs_strerror(n));
+            console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+        } else if (last != '\n') {
+            printf("\n");
+        }
     }
 }
 
@@ -499,18 +672,10 @@ static void cmd_mkdir(int argc, char* argv[]) {
     char path[FS_MAX_FILENAME_LENGTH];
     fs_get_absolute_path(argv[1], current_dir, path, sizeof(path));
     
-    // Ensure path ends with '/'
-    size_t path_len = strlen(path);
-    if (path_len > 0 && path[path_len - 1] != '/') {
-        if (path_len < FS_MAX_FILENAME_LENGTH - 1) {
-            path[path_len] = '/';
-            path[path_len + 1] = '\0';
-        }
-    }
-    
-    if (fs_create_file(path, 1) != 0) {
+    int result = vfs_create(path, true);
+    if (result != 0) {
         console_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
-        printf("mkdir: cannot create directory '%s'\n", argv[1]);
+        printf("mkdir: cannot create directory '%s': %s\n", argv[1], vfs_strerror(result));
         console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
     } else {
         console_set_color(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
@@ -528,9 +693,10 @@ static void cmd_touch(int argc, char* argv[]) {
     char path[FS_MAX_FILENAME_LENGTH];
     fs_get_absolute_path(argv[1], current_dir, path, sizeof(path));
     
-    if (fs_create_file(path, 0) != 0) {
+    int result = vfs_create(path, false);
+    if (result != 0) {
         console_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
-        printf("touch: cannot create file '%s'\n", argv[1]);
+        printf("touch: cannot create file '%s': %s\n", argv[1], vfs_strerror(result));
         console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
     } else {
         console_set_color(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
@@ -541,21 +707,24 @@ static void cmd_touch(int argc, char* argv[]) {
 
 static void cmd_rm(int argc, char* argv[]) {
     if (argc < 2) {
-        printf("Usage: rm <filename>\n");
+        printf("Usage: rm <filename>...\n");
         return;
     }
     
-    char path[FS_MAX_FILENAME_LENGTH];
-    fs_get_absolute_path(argv[1], current_dir, path, sizeof(path));
-    
-    if (fs_delete_file(path) != 0) {
-        console_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
-        printf("rm: cannot remove '%s': No such file or directory\n", argv[1]);
-        console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
-    } else {
-        console_set_color(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
-        printf("'%s' removed successfully\n", argv[1]);
-        console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    for (int i = 1; i < argc; i++) {
+        char path[FS_MAX_FILENAME_LENGTH];
+        fs_get_absolute_path(argv[i], current_dir, path, sizeof(path));
+        
+        int result = vfs_remove(path);
+        if (result != 0) {
+            console_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+            printf("rm: cannot remove '%s': %s\n", argv[i], vfs_strerror(result));
+            console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+        } else {
+            console_set_color(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
+            printf("'%s' removed successfully\n", argv[i]);
+            console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+        }
     }
 }
 
@@ -563,6 +732,16 @@ static void cmd_clear(int argc, char* argv[]) {
     console_clear();
 }
 
+static void cmd_sync(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    if (vfs_sync() != 0) {
+        console_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        printf("sync: failed to write back file system\n");
+        console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    }
+}
+
 static void cmd_pwd(int argc, char* argv[]) {
     console_set_color(VGA_COLOR_LIGHT_BLUE, VGA_COLOR_BLACK);
     printf("%s\n", current_dir);
@@ -582,6 +761,30 @@ static void cmd_stat(int argc, char* argv[]) {
     printf("Free space:      %u bytes (%u KB)\n", free_size, free_size / 1024);
     printf("Total capacity:  %u bytes (%u KB)\n", total_size + free_size, (total_size + free_size) / 1024);
     printf("Usage:           %.1f%%\n", (float)total_size / (total_size + free_size) * 100);
+    
+    // Ratio in hundredths (the libc printf has no precision support); at
+    // most 4 MB is referenced, so the product fits in 32 bits
+    uint32_t logical, physical;
+    fs_get_dedup_stats(&logical, &physical);
+    uint32_t ratio = physical ? logical * 100 / physical : 100;
+    printf("Dedup:           %u KB referenced in %u KB, ratio %u.%u%u, %u bytes saved\n",
+           logical / 1024, physical / 1024, ratio / 100, ratio / 10 % 10, ratio % 10, logical - physical);
+    
+    uint32_t files, extents;
+    fs_get_fragmentation(&files, &extents);
+    printf("Fragmentation:   %u extents in %u files\n", extents, files);
+    
+    block_device_t* disk = fs_disk_get_device();
+    if (disk) {
+        printf("Backing disk:    %s (%u of %u KB of data resident)\n", disk->name,
+               fs_disk_resident_sectors() / 2, FS_DISK_DATA_SECTORS / 2);
+    }
+    if (journal_is_open()) {
+        journal_stats_t js;
+        journal_get_stats(&js);
+        printf("Journal:         %u transactions, %u records, %u sectors, %u checkpoints\n",
+               js.transactions, js.records, js.sectors_written, js.checkpoints);
+    }
 }
 
 static void cmd_mem(int argc, char* argv[]) {
@@ -599,6 +802,204 @@ static void cmd_mem(int argc, char* argv[]) {
     printf("Heap integrity:  %s\n", memory_check_integrity() ? "OK" : "CORRUPTED");
 }
 
+static void cmd_lsblk(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    int count = blockdev_count();
+    
+    if (count == 0) {
+        printf("No block devices\n");
+        return;
+    }
+    
+    console_set_color(VGA_COLOR_LIGHT_BROWN, VGA_COLOR_BLACK);
+    printf("NAME    SIZE        DRIVER     READS      WRITES\n");
+    console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    for (int i = 0; i < count; i++) {
+        block_device_t* dev = blockdev_get_index(i);
+        printf("%-7s %8u KB %-10s %-10u %u\n", dev->name, dev->sector_count / 2,
+               dev->driver, dev->read_requests, dev->write_requests);
+    }
+    
+    bcache_stats_t stats;
+    bcache_get_stats(&stats);
+    printf("\nBuffer cache: %u hits, %u misses, %u read ahead, %u evictions\n",
+           stats.hits, stats.misses, stats.readahead_blocks, stats.evictions);
+    printf("Write-back: %u blocks in %u requests\n", stats.blocks_written, stats.write_requests);
+}
+
+static void cmd_mkfs(int argc, char* argv[]) {
+    if (argc < 2) {
+        printf("Usage: mkfs <device>\n");
+        return;
+    }
+    
+    if (!is_root) {
+        console_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        printf("Permission denied: Only root can format disks\n");
+        console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+        return;
+    }
+    
+    block_device_t* dev = blockdev_get(argv[1]);
+    if (!dev) {
+        console_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        printf("mkfs: %s: No such device\n", argv[1]);
+        console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+        return;
+    }
+    
+    int result = fs_disk_format(dev);
+    if (result != 0) {
+        console_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        printf(result == -1 ? "mkfs: %s: Device too small\n" : "mkfs: %s: I/O error\n", argv[1]);
+        console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+        return;
+    }
+    
+    console_set_color(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
+    printf("File system stored on %s; it will be mounted at boot\n", dev->name);
+    console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+}
+
+static void cmd_mount(int argc, char* argv[]) {
+    if (argc < 3) {
+        for (int i = 0; i < vfs_mount_count(); i++) {
+            const vfs_mount_t* mnt = vfs_get_mount(i);
+            printf("%s on %s type %s (%s)", mnt->source, mnt->path, mnt->ops->name,
+                   mnt->ops->write ? "rw" : "ro");
+            if (mnt->ops == &fat32_vfs_ops) {
+                fat32_volume_t* vol = (fat32_volume_t*)mnt->data;
+                printf(" label '%s', %u clusters, %u chain hits / %u misses",
+                       vol->label, vol->cluster_count, vol->chain_hits, vol->chain_misses);
+            }
+            printf("\n");
+        }
+        return;
+    }
+    
+    block_device_t* dev = blockdev_get(argv[1]);
+    fat32_volume_t* volume = dev ? fat32_mount(dev) : NULL;
+    if (!volume) {
+        console_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        printf("mount: %s: No FAT32 volume found\n", argv[1]);
+        console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+        return;
+    }
+    
+    char path[FS_MAX_FILENAME_LENGTH];
+    fs_get_absolute_path(argv[2], current_dir, path, sizeof(path));
+    if (vfs_mount(path, dev->name, &fat32_vfs_ops, volume) != 0) {
+        printf("mount: Too many mounted file systems\n");
+        return;
+    }
+    
+    console_set_color(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
+    printf("Mounted %s on %s\n", dev->name, path);
+    console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+}
+
+static void cmd_chattr(int argc, char* argv[]) {
+    if (argc < 3 || (strcmp(argv[1], "+c") != 0 && strcmp(argv[1], "-c") != 0)) {
+        printf("Usage: chattr +c|-c <path>\n");
+        return;
+    }
+    
+    char path[FS_MAX_FILENAME_LENGTH];
+    fs_get_absolute_path(argv[2], current_dir, path, sizeof(path));
+    
+    vfs_stat_t st;
+    int result = vfs_set_compression(path, argv[1][0] == '+');
+    if (result == 0) {
+        result = vfs_stat(path, &st);
+    }
+    if (result != 0) {
+        console_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        printf("chattr: %s: %s\n", argv[2], vfs_strerror(result));
+        console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+        return;
+    }
+    
+    if (st.is_directory) {
+        printf("New files in '%s' will %sbe compressed\n", argv[2], argv[1][0] == '+' ? "" : "not ");
+    } else {
+        printf("'%s': %u bytes stored in %u\n", argv[2], st.size, st.stored_size);
+    }
+}
+
+static void cmd_snapshot(int argc, char* argv[]) {
+    if (argc < 2) {
+        uint32_t entries, created;
+        bool any = false;
+        for (int id = 0; id < FS_MAX_SNAPSHOTS; id++) {
+            if (fs_snapshot_info(id, &entries, &created) == 0) {
+                printf("%d: %u entries, taken at %u\n", id, entries, created);
+                any = true;
+            }
+        }
+        if (!any) {
+            printf("No snapshots\n");
+        }
+        return;
+    }
+    
+    if (strcmp(argv[1], "create") == 0) {
+        int id = fs_snapshot_create();
+        if (id < 0) {
+            console_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+            printf("snapshot: all %d slots in use\n", FS_MAX_SNAPSHOTS);
+            console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+            return;
+        }
+        printf("Snapshot %d created\n", id);
+        return;
+    }
+    
+    bool restore = strcmp(argv[1], "restore") == 0;
+    if (argc < 3 || (!restore && strcmp(argv[1], "delete") != 0)) {
+        printf("Usage: snapshot [create | restore <id> | delete <id>]\n");
+        return;
+    }
+    
+    int id = atoi(argv[2]);
+    if ((restore ? fs_snapshot_restore(id) : fs_snapshot_delete(id)) != 0) {
+        console_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        printf("snapshot: no snapshot %s\n", argv[2]);
+        console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+        return;
+    }
+    
+    if (restore) {
+        // The working directory may not exist in the restored tree
+        vfs_stat_t st;
+        if (vfs_stat(current_dir, &st) != 0) {
+            strcpy(current_dir, "/");
+        }
+        printf("Restored snapshot %d\n", id);
+    } else {
+        printf("Deleted snapshot %d\n", id);
+    }
+}
+
+static void cmd_lspci(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    int count = pci_device_count();
+    
+    if (count == 0) {
+        printf("No PCI devices\n");
+        return;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        const pci_device_t* dev = pci_get_device(i);
+        printf("%x:%x.%u  %x:%x  %s (class %x, subclass %x)\n",
+               dev->addr.bus, dev->addr.device, dev->addr.function,
+               dev->vendor_id, dev->device_id, pci_class_name(dev->class_code),
+               dev->class_code, dev->subclass);
+    }
+}
+
 static void cmd_history(int argc, char* argv[]) {
     int count = shell_get_history_count();
     
@@ -624,9 +1025,281 @@ static void cmd_history(int argc, char* argv[]) {
     }
 }
 
+// The file system mounted exactly at path, or NULL
+static const vfs_mount_t* mounted_at(const char* path) {
+    for (int i = 0; i < vfs_mount_count(); i++) {
+        const vfs_mount_t* mnt = vfs_get_mount(i);
+        if (strcmp(mnt->path, path) == 0) {
+            return mnt;
+        }
+    }
+    return NULL;
+}
+
+// Walks stay on one file system, so tree, du, find and grep -r skip
+// whatever is mounted beneath the walked directory
+static int tree_visit(const char* path, const vfs_stat_t* st, uint32_t depth, uint32_t total, void* context) {
+    uint32_t* counts = (uint32_t*)context; // Directories, files
+    for (uint32_t i = 0; i < depth; i++) {
+        printf("|   ");
+    }
+    const vfs_mount_t* mnt = st->is_directory ? mounted_at(path) : NULL;
+    if (mnt) {
+        printf("|-- " CONSOLE_LIGHT_BLUE "%s/" CONSOLE_RESET " (%s mount, not entered)\n", fs_get_filename(path), mnt->ops->name);
+        counts[0]++;
+    } else if (st->is_directory) {
+        printf("|-- " CONSOLE_LIGHT_BLUE "%s/" CONSOLE_RESET " (%u bytes)\n", fs_get_filename(path), total);
+        counts[0]++;
+    } else {
+        printf("|-- %s (%u bytes)\n", fs_get_filename(path), total);
+        counts[1]++;
+    }
+    return 0;
+}
+
 static void cmd_tree(int argc, char* argv[]) {
-    printf("Directory tree feature coming soon!\n");
-    printf("Use 'ls' to list directory contents for now.\n");
+    char path[FS_MAX_FILENAME_LENGTH];
+    fs_get_absolute_path(argc > 1 ? argv[1] : ".", current_dir, path, sizeof(path));
+    
+    uint32_t counts[2] = { 0, 0 };
+    printf("%s\n", path);
+    int result = vfs_walk(path, tree_visit, counts);
+    if (result < 0) {
+        console_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        printf("tree: %s: %s\n", path, vfs_strerror(result));
+        console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+        return;
+    }
+    printf("\n%u directories, %u files\n", counts[0], counts[1]);
+}
+
+typedef struct {
+    bool summary;
+    uint32_t total;
+} du_state_t;
+
+static int du_visit(const char* path, const vfs_stat_t* st, uint32_t depth, uint32_t total, void* context) {
+    du_state_t* du = (du_state_t*)context;
+    if (depth == 0) {
+        du->total += total;
+    }
+    if (st->is_directory && !du->summary) {
+        printf("%u\t%s\n", total, path);
+    }
+    return 0;
+}
+
+static void cmd_du(int argc, char* argv[]) {
+    du_state_t du = { false, 0 };
+    const char* target = ".";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0) {
+            du.summary = true;
+        } else {
+            target = argv[i];
+        }
+    }
+    
+    char path[FS_MAX_FILENAME_LENGTH];
+    fs_get_absolute_path(target, current_dir, path, sizeof(path));
+    int result = vfs_walk(path, du_visit, &du);
+    if (result < 0) {
+        console_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        printf("du: %s: %s\n", path, vfs_strerror(result));
+        console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+        return;
+    }
+    printf("%u\t%s\n", du.total, path);
+}
+
+static int find_visit(const char* path, const vfs_stat_t* st, uint32_t depth, uint32_t total, void* context) {
+    (void)st;
+    (void)depth;
+    (void)total;
+    const char* pattern = (const char*)context;
+    if (!pattern || glob_match(pattern, fs_get_filename(path))) {
+        printf("%s\n", path);
+    }
+    return 0;
+}
+
+static void cmd_find(int argc, char* argv[]) {
+    const char* target = ".";
+    const char* pattern = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-name") == 0 && i + 1 < argc) {
+            pattern = argv[++i];
+        } else if (argv[i][0] == '-') {
+            printf("Usage: find [path] [-name pattern] - stays on one file system\n");
+            return;
+        } else {
+            target = argv[i];
+        }
+    }
+    
+    char path[FS_MAX_FILENAME_LENGTH];
+    fs_get_absolute_path(target, current_dir, path, sizeof(path));
+    int result = vfs_walk(path, find_visit, (void*)pattern);
+    if (result < 0) {
+        console_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        printf("find: %s: %s\n", path, vfs_strerror(result));
+        console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    }
+}
+
+typedef struct {
+    const char* pattern;
+    size_t pattern_len;
+    bool show_names;           // Prefix lines with their file
+    bool line_numbers;
+    uint32_t matches;
+} grep_state_t;
+
+static char grep_buffer[FS_MAX_FILE_SIZE];
+
+// Print the lines of data holding the pattern. line counts the lines
+// before data; returns it advanced past data.
+static uint32_t grep_lines(grep_state_t* grep, const char* path, char* data, size_t size, uint32_t line) {
+    char* end = data + size;
+    char* pos = data;
+    
+    while (pos < end) {
+        char* hit = memmem(pos, end - pos, grep->pattern, grep->pattern_len);
+        if (!hit) {
+            break;
+        }
+        char* start = hit;
+        while (start > pos && start[-1] != '\n') {
+            start--;
+        }
+        char* stop = memchr(hit, '\n', end - hit);
+        if (!stop) {
+            stop = end;
+        }
+        if (grep->line_numbers) {
+            for (char* c = pos; (c = memchr(c, '\n', start - c)) != NULL; c++) {
+                line++;
+            }
+        }
+        
+        char number[12] = "";
+        if (grep->line_numbers) {
+            snprintf(number, sizeof(number), "%u:", line + 1);
+        }
+        if (grep->show_names) {
+            printf(CONSOLE_LIGHT_MAGENTA "%s:" CONSOLE_RESET "%s", path, number);
+        } else {
+            printf("%s", number);
+        }
+        // Lines can be longer than printf's buffer
+        console_write_size(start, stop - start);
+        printf("\n");
+        grep->matches++;
+        if (stop == end) {
+            // Unterminated: the line ends the file or continues in the next chunk
+            pos = end;
+            break;
+        }
+        line++;
+        pos = stop + 1;
+    }
+    
+    if (grep->line_numbers) {
+        for (char* c = pos; c < end && (c = memchr(c, '\n', end - c)) != NULL; c++) {
+            line++;
+        }
+    }
+    return line;
+}
+
+// Search a file a buffer at a time, carrying a partial last line over
+static int grep_file(grep_state_t* grep, const char* path) {
+    uint32_t offset = 0;
+    uint32_t line = 0;
+    size_t kept = 0;
+    int n;
+    
+    while ((n = vfs_read(path, offset, grep_buffer + kept, FS_MAX_FILE_SIZE - kept)) > 0) {
+        offset += n;
+        size_t size = kept + n;
+        size_t done = size;
+        if (size == FS_MAX_FILE_SIZE) {
+            while (done > 0 && grep_buffer[done - 1] != '\n') {
+                done--;
+            }
+            if (done == 0) {
+                done = size; // One line fills the buffer: split it
+            }
+        }
+        line = grep_lines(grep, path, grep_buffer, done, line);
+        kept = size - done;
+        memmove(grep_buffer, grep_buffer + done, kept);
+        if (size < FS_MAX_FILE_SIZE) {
+            break; // Short read: end of file
+        }
+    }
+    if (n < 0) {
+        return n;
+    }
+    grep_lines(grep, path, grep_buffer, kept, line);
+    return 0;
+}
+
+static void grep_error(const char* path, int error) {
+    console_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+    printf("grep: %s: %s\n", path, vfs_strerror(error));
+    console_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+}
+
+static int grep_visit(const char* path, const vfs_stat_t* st, uint32_t depth, uint32_t total, void* context) {
+    (void)depth;
+    (void)total;
+    if (!st->is_directory) {
+        int result = grep_file((grep_state_t*)context, path);
+        if (result < 0) {
+            grep_error(path, result);
+        }
+    }
+    return 0;
+}
+
+static void cmd_grep(int argc, char* argv[]) {
+    grep_state_t grep = { NULL, 0, false, false, 0 };
+    bool recursive = false;
+    int first = 1;
+    
+    for (; first < argc && argv[first][0] == '-'; first++) {
+        if (strcmp(argv[first], "-r") == 0) {
+            recursive = true;
+        } else if (strcmp(argv[first], "-n") == 0) {
+            grep.line_numbers = true;
+        } else {
+            break;
+        }
+    }
+    if (argc - first < 2) {
+        printf("Usage: grep [-r] [-n] <text> <path>... - -r stays on one file system\n");
+        return;
+    }
+    grep.pattern = argv[first];
+    grep.pattern_len = strlen(argv[first]);
+    grep.show_names = recursive || argc - first > 2;
+    
+    for (int i = first + 1; i < argc; i++) {
+        char path[FS_MAX_FILENAME_LENGTH];
+        fs_get_absolute_path(argv[i], current_dir, path, sizeof(path));
+        
+        vfs_stat_t st;
+        int result = vfs_stat(path, &st);
+        if (result == 0 && st.is_directory) {
+            result = recursive ? vfs_walk(path, grep_visit, &grep) : VFS_EISDIR;
+        } else if (result == 0) {
+            result = grep_file(&grep, path);
+        }
+        if (result < 0) {
+            grep_error(argv[i], result);
+        }
+    }
 }
 
 static void cmd_info(int argc, char* argv[]) {
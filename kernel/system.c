@@ -1,19 +1,46 @@
 #include "../include/kernel/system.h"
+#include "../include/kernel/interrupts.h"
 #include "../include/libc/stdio.h"
 
 static uint32_t system_uptime = 0;
 
+#ifndef TEST_MODE
+#define PIT_FREQUENCY 1193182
+#define PIT_CHANNEL0  0x40
+#define PIT_COMMAND   0x43
+
+static volatile uint32_t timer_ticks = 0;
+
+static void timer_irq(interrupt_frame_t* frame) {
+    (void)frame;
+    timer_ticks++;
+}
+#endif
+
 void system_init(void) {
     system_uptime = 0;
-    
+
 #ifndef TEST_MODE
-    // In kernel mode, we would initialize interrupts, timers, etc.
+    interrupts_init();
+
+    // PIT channel 0 in square wave mode drives the system tick
+    uint16_t divisor = PIT_FREQUENCY / SYSTEM_TIMER_HZ;
+    outb(PIT_COMMAND, 0x36);
+    outb(PIT_CHANNEL0, divisor & 0xFF);
+    outb(PIT_CHANNEL0, divisor >> 8);
+    irq_register_handler(IRQ_TIMER, timer_irq);
+
+    sti();
     printf("System components initialized\n");
 #endif
 }
 
 uint32_t system_get_uptime(void) {
+#ifdef TEST_MODE
     return ++system_uptime; // Simple increment for now
+#else
+    return timer_ticks;
+#endif
 }
 
 void system_delay(uint32_t ms) {
@@ -21,9 +48,12 @@ void system_delay(uint32_t ms) {
     // In test mode, use system sleep
     usleep(ms * 1000);
 #else
-    // Simple busy wait (not accurate, but works for demonstration)
-    for (volatile uint32_t i = 0; i < ms * 1000; i++) {
-        // Busy wait
+    // Sleep on the timer tick instead of spinning
+    uint32_t end = timer_ticks + (ms * SYSTEM_TIMER_HZ + 999) / 1000;
+    bool enabled = irq_save();
+    while ((int32_t)(end - timer_ticks) > 0) {
+        cpu_idle();
     }
+    irq_restore(enabled);
 #endif
 }
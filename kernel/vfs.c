@@ -0,0 +1,347 @@
+#include "../include/kernel/vfs.h"
+#include "../include/libc/string.h"
+
+static vfs_mount_t mounts[VFS_MAX_MOUNTS];
+static int num_mounts = 0;
+
+// /tmp lives in its own RAM-only instance: it is never logged or written
+// to the backing disk, and its files do not use up the root's data area
+static filesystem_t tmp_fs;
+
+// Find the mount covering an absolute path; *rest gets the path inside it
+static vfs_mount_t* resolve(const char* path, const char** rest) {
+    vfs_mount_t* best = NULL;
+
+    for (int i = 0; i < num_mounts; i++) {
+        size_t len = mounts[i].prefix_len;
+        if ((best == NULL || len > best->prefix_len) &&
+            strncmp(path, mounts[i].path, len) == 0 &&
+            (path[len] == '\0' || path[len] == '/')) {
+            best = &mounts[i];
+        }
+    }
+
+    if (best) {
+        *rest = path[best->prefix_len] ? path + best->prefix_len : "/";
+    }
+    return best;
+}
+
+int vfs_mount(const char* path, const char* source, const vfs_ops_t* ops, void* data) {
+    if (num_mounts >= VFS_MAX_MOUNTS || path[0] != '/' || strlen(path) >= FS_MAX_FILENAME_LENGTH) {
+        return -1;
+    }
+
+    // Make the mount point show up when its parent is listed
+    const char* rest;
+    vfs_mount_t* parent = resolve(path, &rest);
+    vfs_stat_t st;
+    if (parent && parent->ops->create && parent->ops->stat(parent, rest, &st) == VFS_ENOENT) {
+        parent->ops->create(parent, rest, true);
+    }
+
+    vfs_mount_t* mnt = &mounts[num_mounts++];
+    strcpy(mnt->path, path);
+    mnt->prefix_len = strcmp(path, "/") == 0 ? 0 : strlen(path);
+    strncpy(mnt->source, source, VFS_SOURCE_LENGTH - 1);
+    mnt->source[VFS_SOURCE_LENGTH - 1] = '\0';
+    mnt->ops = ops;
+    mnt->data = data;
+    return 0;
+}
+
+void vfs_init(void) {
+    num_mounts = 0;
+
+    filesystem_t* previous = fs_use(&tmp_fs);
+    fs_format();
+    fs_use(previous);
+
+    vfs_mount("/", "rootfs", &ramfs_ops, NULL);
+    vfs_mount("/tmp", "tmpfs", &ramfs_ops, &tmp_fs);
+    vfs_mount("/dev", "devfs", &devfs_ops, NULL);
+    vfs_mount("/proc", "proc", &procfs_ops, NULL);
+}
+
+int vfs_stat(const char* path, vfs_stat_t* st) {
+    const char* rest;
+    vfs_mount_t* mnt = resolve(path, &rest);
+    if (!mnt) {
+        return VFS_ENOENT;
+    }
+    return mnt->ops->stat(mnt, rest, st);
+}
+
+int vfs_read(const char* path, uint32_t offset, void* buffer, size_t size) {
+    const char* rest;
+    vfs_mount_t* mnt = resolve(path, &rest);
+    if (!mnt) {
+        return VFS_ENOENT;
+    }
+    if (!mnt->ops->read) {
+        return VFS_EISDIR;
+    }
+    return mnt->ops->read(mnt, rest, offset, buffer, size);
+}
+
+int vfs_write(const char* path, const void* data, size_t size) {
+    const char* rest;
+    vfs_mount_t* mnt = resolve(path, &rest);
+    if (!mnt) {
+        return VFS_ENOENT;
+    }
+    if (!mnt->ops->write) {
+        return VFS_EROFS;
+    }
+    return mnt->ops->write(mnt, rest, data, size);
+}
+
+int vfs_create(const char* path, bool is_directory) {
+    const char* rest;
+    vfs_mount_t* mnt = resolve(path, &rest);
+    if (!mnt) {
+        return VFS_ENOENT;
+    }
+    if (strcmp(rest, "/") == 0) {
+        return VFS_EEXIST; // A mount root always exists
+    }
+    if (!mnt->ops->create) {
+        return VFS_EROFS;
+    }
+    return mnt->ops->create(mnt, rest, is_directory);
+}
+
+int vfs_remove(const char* path) {
+    const char* rest;
+    vfs_mount_t* mnt = resolve(path, &rest);
+    if (!mnt) {
+        return VFS_ENOENT;
+    }
+    if (strcmp(rest, "/") == 0) {
+        return VFS_EBUSY;
+    }
+    if (!mnt->ops->remove) {
+        return VFS_EROFS;
+    }
+    return mnt->ops->remove(mnt, rest);
+}
+
+int vfs_list(const char* path, char* buffer, size_t size) {
+    const char* rest;
+    vfs_mount_t* mnt = resolve(path, &rest);
+    if (!mnt) {
+        return VFS_ENOENT;
+    }
+    return mnt->ops->list(mnt, rest, buffer, size);
+}
+
+int vfs_set_compression(const char* path, bool enable) {
+    const char* rest;
+    vfs_mount_t* mnt = resolve(path, &rest);
+    if (!mnt) {
+        return VFS_ENOENT;
+    }
+    if (!mnt->ops->compress) {
+        return VFS_ENOTSUP;
+    }
+    return mnt->ops->compress(mnt, rest, enable);
+}
+
+int vfs_walk(const char* path, vfs_walk_fn visit, void* context) {
+    const char* rest;
+    vfs_mount_t* mnt = resolve(path, &rest);
+    if (!mnt) {
+        return VFS_ENOENT;
+    }
+    if (!mnt->ops->walk) {
+        return VFS_ENOTSUP;
+    }
+    return mnt->ops->walk(mnt, rest, visit, context);
+}
+
+int vfs_sync(void) {
+    int result = 0;
+    for (int i = 0; i < num_mounts; i++) {
+        if (mounts[i].ops->sync) {
+            int r = mounts[i].ops->sync(&mounts[i]);
+            if (r != 0 && result == 0) {
+                result = r;
+            }
+        }
+    }
+    return result;
+}
+
+int vfs_mount_count(void) {
+    return num_mounts;
+}
+
+const vfs_mount_t* vfs_get_mount(int index) {
+    if (index < 0 || index >= num_mounts) {
+        return NULL;
+    }
+    return &mounts[index];
+}
+
+const char* vfs_strerror(int error) {
+    switch (error) {
+        case VFS_ENOENT: return "No such file or directory";
+        case VFS_EROFS:  return "Read-only file system";
+        case VFS_EIO:    return "I/O error";
+        case VFS_EISDIR: return "Is a directory";
+        case VFS_ENOSPC: return "No space left on device";
+        case VFS_EEXIST: return "File exists";
+        case VFS_EBUSY:  return "Device or resource busy";
+        case VFS_ENOTSUP: return "Operation not supported";
+        default:         return "Unknown error";
+    }
+}
+
+// ramfs: the in-memory fs.c tables. Each call makes the mount's instance
+// current for its duration, so files are served straight from memory.
+
+static filesystem_t* ramfs_enter(vfs_mount_t* mnt) {
+    return mnt->data ? fs_use((filesystem_t*)mnt->data) : fs_get_instance();
+}
+
+static int ramfs_stat(vfs_mount_t* mnt, const char* path, vfs_stat_t* st) {
+    filesystem_t* previous = ramfs_enter(mnt);
+    const fs_entry_t* entry = fs_lookup(path);
+    if (entry) {
+        st->size = entry->size;
+        st->stored_size = fs_entry_stored_size(entry);
+        st->is_directory = entry->is_directory;
+        st->permissions = entry->permissions;
+        st->modified_time = entry->modified_time;
+    }
+    fs_use(previous);
+    return entry ? 0 : VFS_ENOENT;
+}
+
+static int ramfs_read(vfs_mount_t* mnt, const char* path, uint32_t offset, void* buffer, size_t size) {
+    filesystem_t* previous = ramfs_enter(mnt);
+    int result = fs_read_at(path, offset, buffer, size);
+    fs_use(previous);
+
+    switch (result) {
+        case -1: return VFS_EISDIR;
+        case -2: return VFS_ENOENT;
+        case -3: return VFS_EIO;
+        default: return result;
+    }
+}
+
+static int ramfs_write(vfs_mount_t* mnt, const char* path, const void* data, size_t size) {
+    filesystem_t* previous = ramfs_enter(mnt);
+    int result = fs_write_file(path, data, size);
+    fs_use(previous);
+
+    switch (result) {
+        case 0:  return 0;
+        case -3: return VFS_EISDIR;
+        case -5: return VFS_EIO;
+        default: return VFS_ENOSPC;
+    }
+}
+
+static int ramfs_create(vfs_mount_t* mnt, const char* path, bool is_directory) {
+    filesystem_t* previous = ramfs_enter(mnt);
+    int result = fs_lookup(path) ? -2 : fs_create_file(path, is_directory);
+    fs_use(previous);
+
+    switch (result) {
+        case 0:  return 0;
+        case -2: return VFS_EEXIST;
+        default: return VFS_ENOSPC;
+    }
+}
+
+static int ramfs_remove(vfs_mount_t* mnt, const char* path) {
+    filesystem_t* previous = ramfs_enter(mnt);
+    const fs_entry_t* entry = fs_lookup(path);
+    int result = entry ? fs_delete_file(entry->filename) : -1;
+    fs_use(previous);
+    return result == 0 ? 0 : VFS_ENOENT;
+}
+
+static int ramfs_list(vfs_mount_t* mnt, const char* path, char* buffer, size_t size) {
+    filesystem_t* previous = ramfs_enter(mnt);
+    const fs_entry_t* entry = fs_lookup(path);
+    int result = VFS_ENOENT;
+    if (entry && entry->is_directory) {
+        result = fs_list_directory(path, buffer, size);
+    }
+    fs_use(previous);
+    return result;
+}
+
+static int ramfs_compress(vfs_mount_t* mnt, const char* path, bool enable) {
+    filesystem_t* previous = ramfs_enter(mnt);
+    int result = fs_set_compression(path, enable);
+    fs_use(previous);
+
+    switch (result) {
+        case 0:  return 0;
+        case -1: return VFS_ENOENT;
+        case -3: return VFS_EIO;
+        default: return VFS_ENOSPC;
+    }
+}
+
+typedef struct {
+    vfs_mount_t* mnt;
+    vfs_walk_fn visit;
+    void* context;
+} ramfs_walk_t;
+
+// Turn each fs_walk entry into an absolute path and a stat for the caller
+static int ramfs_walk_entry(const fs_entry_t* entry, uint32_t depth, uint32_t total, void* context) {
+    ramfs_walk_t* walk = (ramfs_walk_t*)context;
+    char path[FS_MAX_FILENAME_LENGTH];
+    size_t prefix_len = walk->mnt->prefix_len;
+    
+    memcpy(path, walk->mnt->path, prefix_len);
+    strncpy(path + prefix_len, entry->filename, sizeof(path) - prefix_len - 1);
+    path[sizeof(path) - 1] = '\0';
+    size_t len = strlen(path);
+    if (len > 1 && path[len - 1] == '/') {
+        path[len - 1] = '\0';
+    }
+    
+    vfs_stat_t st;
+    st.size = entry->size;
+    st.stored_size = fs_entry_stored_size(entry);
+    st.is_directory = entry->is_directory;
+    st.permissions = entry->permissions;
+    st.modified_time = entry->modified_time;
+    return walk->visit(path, &st, depth, total, walk->context);
+}
+
+static int ramfs_walk(vfs_mount_t* mnt, const char* path, vfs_walk_fn visit, void* context) {
+    ramfs_walk_t walk = { mnt, visit, context };
+    filesystem_t* previous = ramfs_enter(mnt);
+    int result = fs_walk(path, ramfs_walk_entry, &walk);
+    fs_use(previous);
+    return result < 0 ? VFS_ENOENT : result;
+}
+
+static int ramfs_sync(vfs_mount_t* mnt) {
+    // Only the global instance has a backing store
+    if (mnt->data) {
+        return 0;
+    }
+    return fs_sync() == 0 ? 0 : VFS_EIO;
+}
+
+const vfs_ops_t ramfs_ops = {
+    .name = "ramfs",
+    .stat = ramfs_stat,
+    .read = ramfs_read,
+    .write = ramfs_write,
+    .create = ramfs_create,
+    .remove = ramfs_remove,
+    .list = ramfs_list,
+    .sync = ramfs_sync,
+    .compress = ramfs_compress,
+    .walk = ramfs_walk,
+};
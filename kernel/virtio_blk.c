@@ -0,0 +1,324 @@
+#include "../include/kernel/virtio_blk.h"
+#include "../include/kernel/blockdev.h"
+#include "../include/kernel/interrupts.h"
+#include "../include/kernel/pci.h"
+#include "../include/kernel/system.h"
+#include "../include/libc/string.h"
+
+#ifndef TEST_MODE
+// Kernel mode only - legacy (transitional) virtio over PCI I/O space
+
+#define VIRTIO_VENDOR_ID     0x1AF4
+#define VIRTIO_BLK_DEVICE_ID 0x1001
+
+// Legacy register layout behind BAR0
+#define VIRTIO_REG_DEVICE_FEATURES 0x00
+#define VIRTIO_REG_GUEST_FEATURES  0x04
+#define VIRTIO_REG_QUEUE_ADDRESS   0x08
+#define VIRTIO_REG_QUEUE_SIZE      0x0C
+#define VIRTIO_REG_QUEUE_SELECT    0x0E
+#define VIRTIO_REG_QUEUE_NOTIFY    0x10
+#define VIRTIO_REG_DEVICE_STATUS   0x12
+#define VIRTIO_REG_ISR_STATUS      0x13
+#define VIRTIO_REG_BLK_CAPACITY    0x14
+
+#define VIRTIO_STATUS_ACKNOWLEDGE 1
+#define VIRTIO_STATUS_DRIVER      2
+#define VIRTIO_STATUS_DRIVER_OK   4
+#define VIRTIO_STATUS_FAILED      128
+
+#define VIRTIO_BLK_F_RO (1 << 5)
+
+#define VIRTQ_DESC_F_NEXT  1
+#define VIRTQ_DESC_F_WRITE 2   // Device writes into this buffer
+#define VIRTQ_USED_F_NO_NOTIFY 1
+#define VIRTQ_ALIGN 4096
+
+#define VIRTIO_BLK_T_IN  0
+#define VIRTIO_BLK_T_OUT 1
+#define VIRTIO_BLK_S_OK  0
+
+// Every request uses a fixed chain of three descriptors
+#define VIRTIO_BLK_DESC_PER_REQUEST 3
+#define VIRTIO_BLK_MAX_SLOTS (VIRTIO_BLK_MAX_QUEUE_SIZE / VIRTIO_BLK_DESC_PER_REQUEST)
+#define VIRTIO_BLK_TIMEOUT_TICKS (5 * SYSTEM_TIMER_HZ)
+
+#define VIRTQ_ALIGN_UP(x) (((x) + VIRTQ_ALIGN - 1) & ~(VIRTQ_ALIGN - 1))
+#define VIRTQ_MEMORY_SIZE(n) (VIRTQ_ALIGN_UP(16 * (n) + 6 + 2 * (n)) + VIRTQ_ALIGN_UP(6 + 8 * (n)))
+
+typedef struct {
+    uint64_t address;
+    uint32_t length;
+    uint16_t flags;
+    uint16_t next;
+} __attribute__((packed)) virtq_desc_t;
+
+typedef struct {
+    uint16_t flags;
+    uint16_t idx;
+    uint16_t ring[];
+} __attribute__((packed)) virtq_avail_t;
+
+typedef struct {
+    uint32_t id;
+    uint32_t length;
+} __attribute__((packed)) virtq_used_elem_t;
+
+typedef struct {
+    uint16_t flags;
+    uint16_t idx;
+    virtq_used_elem_t ring[];
+} __attribute__((packed)) virtq_used_t;
+
+typedef struct {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t sector;
+} __attribute__((packed)) virtio_blk_header_t;
+
+typedef struct {
+    uint16_t io_base;
+    uint16_t queue_size;
+    uint16_t num_slots;
+    uint16_t last_used_idx;
+    
+    virtq_desc_t* desc;
+    volatile virtq_avail_t* avail;
+    volatile virtq_used_t* used;
+    
+    // Per-slot request headers and status bytes the device reads/writes
+    virtio_blk_header_t headers[VIRTIO_BLK_MAX_SLOTS];
+    volatile uint8_t status[VIRTIO_BLK_MAX_SLOTS];
+    block_request_t* inflight[VIRTIO_BLK_MAX_SLOTS];
+    uint16_t free_slots[VIRTIO_BLK_MAX_SLOTS];
+    uint16_t num_free;
+    bool failed;               // Reset after a timeout; every request fails
+    
+    block_device_t dev;
+} virtio_blk_t;
+
+static uint8_t queue_memory[VIRTIO_BLK_MAX_DEVICES][VIRTQ_MEMORY_SIZE(VIRTIO_BLK_MAX_QUEUE_SIZE)]
+    __attribute__((aligned(VIRTQ_ALIGN)));
+static virtio_blk_t disks[VIRTIO_BLK_MAX_DEVICES];
+static int num_disks = 0;
+
+// Put one request on its descriptor chain and the avail ring (not yet published)
+static void virtio_blk_queue(virtio_blk_t* vb, block_request_t* req, uint16_t avail_idx) {
+    uint16_t slot = vb->free_slots[--vb->num_free];
+    uint16_t head = slot * VIRTIO_BLK_DESC_PER_REQUEST;
+    virtq_desc_t* d = &vb->desc[head];
+    
+    vb->headers[slot].type = req->write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+    vb->headers[slot].reserved = 0;
+    vb->headers[slot].sector = req->lba;
+    vb->status[slot] = 0xFF;
+    vb->inflight[slot] = req;
+    
+    d[0].address = (uint32_t)&vb->headers[slot];
+    d[0].length = sizeof(virtio_blk_header_t);
+    d[0].flags = VIRTQ_DESC_F_NEXT;
+    d[0].next = head + 1;
+    
+    // Paging is off, so the caller's buffer address is its physical address
+    d[1].address = (uint32_t)req->buffer;
+    d[1].length = req->count * BLOCKDEV_SECTOR_SIZE;
+    d[1].flags = VIRTQ_DESC_F_NEXT | (req->write ? 0 : VIRTQ_DESC_F_WRITE);
+    d[1].next = head + 2;
+    
+    d[2].address = (uint32_t)&vb->status[slot];
+    d[2].length = 1;
+    d[2].flags = VIRTQ_DESC_F_WRITE;
+    d[2].next = 0;
+    
+    vb->avail->ring[avail_idx % vb->queue_size] = head;
+}
+
+// Retire everything the device has finished since the last call
+static uint32_t virtio_blk_reap(virtio_blk_t* vb, int* result) {
+    uint32_t completed = 0;
+    
+    while (vb->last_used_idx != vb->used->idx) {
+        memory_barrier();
+        uint16_t head = vb->used->ring[vb->last_used_idx % vb->queue_size].id;
+        uint16_t slot = head / VIRTIO_BLK_DESC_PER_REQUEST;
+        
+        block_request_t* req = vb->inflight[slot];
+        req->status = (vb->status[slot] == VIRTIO_BLK_S_OK) ? 0 : -1;
+        if (req->status != 0) {
+            *result = req->status;
+        }
+        
+        vb->inflight[slot] = NULL;
+        vb->free_slots[vb->num_free++] = slot;
+        vb->last_used_idx++;
+        completed++;
+    }
+    return completed;
+}
+
+// Give up on a device that stopped responding. Resetting it stops any
+// access to the in-flight buffers, which belong to callers about to return.
+static void virtio_blk_fail(virtio_blk_t* vb) {
+    outb(vb->io_base + VIRTIO_REG_DEVICE_STATUS, 0);
+    outb(vb->io_base + VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_FAILED);
+    vb->failed = true;
+    
+    vb->num_free = 0;
+    for (int slot = vb->num_slots - 1; slot >= 0; slot--) {
+        if (vb->inflight[slot]) {
+            vb->inflight[slot]->status = -2;
+            vb->inflight[slot] = NULL;
+        }
+        vb->free_slots[vb->num_free++] = slot;
+    }
+}
+
+static int virtio_blk_submit(block_device_t* dev, block_request_t* requests, uint32_t count) {
+    virtio_blk_t* vb = (virtio_blk_t*)dev->driver_data;
+    uint32_t submitted = 0;
+    uint32_t completed = 0;
+    int result = 0;
+    
+    if (vb->failed) {
+        for (uint32_t i = 0; i < count; i++) {
+            requests[i].status = -2;
+        }
+        return -2;
+    }
+    
+    while (completed < count) {
+        // Fill every free slot, then publish the whole batch with one notify
+        uint16_t avail_idx = vb->avail->idx;
+        uint16_t queued = 0;
+        while (submitted < count && vb->num_free > 0) {
+            virtio_blk_queue(vb, &requests[submitted++], avail_idx + queued);
+            queued++;
+        }
+        
+        if (queued > 0) {
+            memory_barrier();
+            vb->avail->idx = avail_idx + queued;
+            memory_barrier();
+            if (!(vb->used->flags & VIRTQ_USED_F_NO_NOTIFY)) {
+                outw(vb->io_base + VIRTIO_REG_QUEUE_NOTIFY, 0);
+            }
+        }
+        
+        // Sleep until the device reports progress, then reap the lot
+        uint32_t deadline = system_get_uptime() + VIRTIO_BLK_TIMEOUT_TICKS;
+        bool enabled = irq_save();
+        while (vb->last_used_idx == vb->used->idx && (int32_t)(deadline - system_get_uptime()) > 0) {
+            cpu_idle();
+        }
+        irq_restore(enabled);
+        
+        uint32_t reaped = virtio_blk_reap(vb, &result);
+        if (reaped == 0) {
+            // Device stopped responding
+            virtio_blk_fail(vb);
+            for (uint32_t i = submitted; i < count; i++) {
+                requests[i].status = -2;
+            }
+            return -2;
+        }
+        completed += reaped;
+    }
+    return result;
+}
+
+static int virtio_blk_read(block_device_t* dev, uint32_t lba, uint32_t count, void* buffer) {
+    block_request_t req = { lba, count, buffer, false, 0 };
+    return virtio_blk_submit(dev, &req, 1);
+}
+
+static int virtio_blk_write(block_device_t* dev, uint32_t lba, uint32_t count, const void* buffer) {
+    block_request_t req = { lba, count, (void*)buffer, true, 0 };
+    return virtio_blk_submit(dev, &req, 1);
+}
+
+static void virtio_blk_irq(interrupt_frame_t* frame) {
+    (void)frame;
+    // Reading the ISR status register acknowledges the interrupt; the
+    // submitter wakes from hlt and checks the used ring itself
+    for (int i = 0; i < num_disks; i++) {
+        inb(disks[i].io_base + VIRTIO_REG_ISR_STATUS);
+    }
+}
+
+static int virtio_blk_setup(virtio_blk_t* vb, const pci_device_t* pci, int index) {
+    uint32_t bar0 = pci_config_read32(pci->addr, PCI_BAR0);
+    if (!(bar0 & 1)) {
+        return -1; // Legacy interface needs an I/O BAR
+    }
+    vb->io_base = bar0 & 0xFFFC;
+    pci_enable_bus_master(pci->addr);
+    
+    // Reset, then announce ourselves
+    outb(vb->io_base + VIRTIO_REG_DEVICE_STATUS, 0);
+    outb(vb->io_base + VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_ACKNOWLEDGE);
+    outb(vb->io_base + VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+    
+    uint32_t features = inl(vb->io_base + VIRTIO_REG_DEVICE_FEATURES);
+    outl(vb->io_base + VIRTIO_REG_GUEST_FEATURES, features & VIRTIO_BLK_F_RO);
+    
+    outw(vb->io_base + VIRTIO_REG_QUEUE_SELECT, 0);
+    vb->queue_size = inw(vb->io_base + VIRTIO_REG_QUEUE_SIZE);
+    if (vb->queue_size == 0 || vb->queue_size > VIRTIO_BLK_MAX_QUEUE_SIZE) {
+        outb(vb->io_base + VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_FAILED);
+        return -2; // No queue, or larger than we reserved memory for
+    }
+    
+    // Legacy layout: descriptors, avail ring, then the used ring on the next page
+    uint8_t* mem = queue_memory[index];
+    memset(mem, 0, VIRTQ_MEMORY_SIZE(VIRTIO_BLK_MAX_QUEUE_SIZE));
+    vb->desc = (virtq_desc_t*)mem;
+    vb->avail = (volatile virtq_avail_t*)(mem + 16 * vb->queue_size);
+    vb->used = (volatile virtq_used_t*)(mem + VIRTQ_ALIGN_UP(16 * vb->queue_size + 6 + 2 * vb->queue_size));
+    vb->last_used_idx = 0;
+    vb->failed = false;
+    
+    vb->num_slots = vb->queue_size / VIRTIO_BLK_DESC_PER_REQUEST;
+    vb->num_free = 0;
+    for (int slot = vb->num_slots - 1; slot >= 0; slot--) {
+        vb->free_slots[vb->num_free++] = slot;
+    }
+    
+    outl(vb->io_base + VIRTIO_REG_QUEUE_ADDRESS, (uint32_t)mem / VIRTQ_ALIGN);
+    outb(vb->io_base + VIRTIO_REG_DEVICE_STATUS,
+         VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER | VIRTIO_STATUS_DRIVER_OK);
+    
+    uint32_t capacity_low = inl(vb->io_base + VIRTIO_REG_BLK_CAPACITY);
+    uint32_t capacity_high = inl(vb->io_base + VIRTIO_REG_BLK_CAPACITY + 4);
+    
+    vb->dev.name[0] = 'v';
+    vb->dev.name[1] = 'd';
+    vb->dev.name[2] = 'a' + index;
+    vb->dev.name[3] = '\0';
+    vb->dev.driver = "virtio-blk";
+    vb->dev.sector_count = capacity_high ? 0xFFFFFFFF : capacity_low;
+    vb->dev.read = virtio_blk_read;
+    vb->dev.write = (features & VIRTIO_BLK_F_RO) ? NULL : virtio_blk_write;
+    vb->dev.submit = virtio_blk_submit;
+    vb->dev.driver_data = vb;
+    
+    if (pci->irq_line < IRQ_COUNT) {
+        irq_register_handler(pci->irq_line, virtio_blk_irq);
+    }
+    return blockdev_register(&vb->dev);
+}
+
+int virtio_blk_init(void) {
+    for (int i = 0; i < pci_device_count() && num_disks < VIRTIO_BLK_MAX_DEVICES; i++) {
+        const pci_device_t* pci = pci_get_device(i);
+        if (pci->vendor_id != VIRTIO_VENDOR_ID || pci->device_id != VIRTIO_BLK_DEVICE_ID) {
+            continue;
+        }
+        
+        if (virtio_blk_setup(&disks[num_disks], pci, num_disks) == 0) {
+            num_disks++;
+        }
+    }
+    return num_disks;
+}
+
+#endif
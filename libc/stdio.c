@@ -3,26 +3,17 @@
 #include "../include/libc/string.h"
 
 #ifdef TEST_MODE
-// In test mode, use system stdio
+// In test mode, use system stdio types; output still goes through the
+// console, which buffers it
 #include <stdio.h>
 #include <stdarg.h>
-
-int putchar(int c) {
-    return fputc(c, stdout);  // Changed from putchar(c) to avoid recursion
-}
-
-int puts(const char* str) {
-    return fputs(str, stdout);  // Changed from puts(str) to avoid recursion
-}
-
 #else
 // For kernel mode, we need our own va_list
 typedef __builtin_va_list va_list;
 #define va_start(v,l) __builtin_va_start(v,l)
 #define va_end(v) __builtin_va_end(v)
 #define va_arg(v,l) __builtin_va_arg(v,l)
-
-// Kernel mode implementation
+#endif
 
 int putchar(int c) {
     console_putchar((char)c);
@@ -35,8 +26,6 @@ int puts(const char* str) {
     return 0;
 }
 
-#endif
-
 // Common implementation for both modes
 int printf(const char* format, ...) {
     va_list args;
@@ -49,12 +38,7 @@ int printf(const char* format, ...) {
 int vprintf(const char* format, va_list args) {
     char buffer[1024];
     int result = vsprintf(buffer, format, args);
-    
-#ifdef TEST_MODE
-    printf("%s", buffer);
-#else
     console_write(buffer);
-#endif
     
     return result;
 }
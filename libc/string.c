@@ -66,6 +66,55 @@ void* memchr(const void* s, int c, size_t n) {
     return NULL;
 }
 
+// Unaligned 32-bit load; x86 allows these at full speed
+typedef uint32_t __attribute__((may_alias, aligned(1))) unaligned_u32;
+
+// Each step tests four starting positions at once: a word at the start and
+// one at the end of the window are XORed with the needle's first and last
+// bytes repeated, and a zero byte in either marks a candidate. Only
+// candidates are compared in full.
+void* memmem(const void* haystack, size_t haystack_len, const void* needle, size_t needle_len) {
+    const unsigned char* h = (const unsigned char*)haystack;
+    const unsigned char* n = (const unsigned char*)needle;
+    
+    if (needle_len == 0) {
+        return (void*)h;
+    }
+    if (needle_len > haystack_len) {
+        return NULL;
+    }
+    if (needle_len == 1) {
+        return memchr(h, n[0], haystack_len);
+    }
+    
+    uint32_t first = n[0] * 0x01010101u;
+    uint32_t last = n[needle_len - 1] * 0x01010101u;
+    size_t end = haystack_len - needle_len; // Last possible match position
+    size_t i = 0;
+    
+    for (; i + 3 <= end; i += 4) {
+        uint32_t x = (*(const unaligned_u32*)(h + i) ^ first) |
+                     (*(const unaligned_u32*)(h + i + needle_len - 1) ^ last);
+        // Flags every zero byte (and possibly a few above one: rechecked)
+        uint32_t zero = (x - 0x01010101u) & ~x & 0x80808080u;
+        while (zero) {
+            size_t k = i + __builtin_ctz(zero) / 8;
+            if (memcmp(h + k, n, needle_len) == 0) {
+                return (void*)(h + k);
+            }
+            zero &= zero - 1;
+        }
+    }
+    
+    for (; i <= end; i++) {
+        if (h[i] == n[0] && memcmp(h + i, n, needle_len) == 0) {
+            return (void*)(h + i);
+        }
+    }
+    
+    return NULL;
+}
+
 size_t strlen(const char* s) {
     size_t len = 0;
     while (s[len] != '\0') {
@@ -173,27 +222,7 @@ char* strrchr(const char* s, int c) {
 }
 
 char* strstr(const char* haystack, const char* needle) {
-    if (*needle == '\0') {
-        return (char*)haystack;
-    }
-    
-    while (*haystack != '\0') {
-        const char* h = haystack;
-        const char* n = needle;
-        
-        while (*h == *n && *n != '\0') {
-            h++;
-            n++;
-        }
-        
-        if (*n == '\0') {
-            return (char*)haystack;
-        }
-        
-        haystack++;
-    }
-    
-    return NULL;
+    return (char*)memmem(haystack, strlen(haystack), needle, strlen(needle));
 }
 
 char* strtok(char* str, const char* delim) {
@@ -0,0 +1,117 @@
+#include "../include/kernel/fs.h"
+#include "../include/kernel/memory.h"
+#include "../include/libc/stdio.h"
+#include "../include/libc/string.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+// Host-side image builder: populates a filesystem_t from a host directory
+// and writes it out as an image the kernel adopts without replaying creates.
+//
+// Usage: mkfsimage <output.img> [host_dir]
+
+static int files_added = 0;
+static int files_skipped = 0;
+
+static void import_file(const char* host_path, const char* fs_path) {
+    static char data[FS_MAX_FILE_SIZE];
+
+    FILE* f = fopen(host_path, "rb");
+    if (!f) {
+        fprintf(stderr, "mkfsimage: cannot open %s\n", host_path);
+        files_skipped++;
+        return;
+    }
+
+    size_t size = fread(data, 1, sizeof(data), f);
+    int too_large = fgetc(f) != EOF;
+    fclose(f);
+
+    if (too_large) {
+        fprintf(stderr, "mkfsimage: skipping %s (larger than %d bytes)\n", host_path, FS_MAX_FILE_SIZE);
+        files_skipped++;
+        return;
+    }
+
+    if (fs_write_file(fs_path, data, size) != 0) {
+        fprintf(stderr, "mkfsimage: no space for %s\n", fs_path);
+        files_skipped++;
+        return;
+    }
+    files_added++;
+}
+
+static void import_directory(const char* host_dir, const char* fs_dir) {
+    DIR* dir = opendir(host_dir);
+    if (!dir) {
+        fprintf(stderr, "mkfsimage: cannot read directory %s\n", host_dir);
+        return;
+    }
+
+    struct dirent* de;
+    while ((de = readdir(dir)) != NULL) {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) {
+            continue;
+        }
+
+        char host_path[1024];
+        char fs_path[FS_MAX_FILENAME_LENGTH];
+        snprintf(host_path, sizeof(host_path), "%s/%s", host_dir, de->d_name);
+        snprintf(fs_path, sizeof(fs_path), "%s/%s", strcmp(fs_dir, "/") == 0 ? "" : fs_dir, de->d_name);
+
+        struct stat st;
+        if (stat(host_path, &st) != 0) {
+            continue;
+        }
+
+        if (S_ISDIR(st.st_mode)) {
+            fs_create_file(fs_path, 1); // May already exist from fs_init
+            import_directory(host_path, fs_path);
+        } else if (S_ISREG(st.st_mode)) {
+            import_file(host_path, fs_path);
+        }
+    }
+
+    closedir(dir);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <output.img> [host_dir]\n", argv[0]);
+        return 1;
+    }
+
+    memory_init();
+
+    // Start from the standard layout so images boot like a fresh system
+    fs_init();
+
+    if (argc > 2) {
+        import_directory(argv[2], "/");
+    }
+
+    FILE* out = fopen(argv[1], "wb");
+    if (!out) {
+        fprintf(stderr, "mkfsimage: cannot create %s\n", argv[1]);
+        return 1;
+    }
+
+    fs_image_header_t header;
+    fs_init_image_header(&header);
+
+    if (fwrite(&header, sizeof(header), 1, out) != 1 ||
+        fwrite(fs_get_instance(), sizeof(filesystem_t), 1, out) != 1) {
+        fprintf(stderr, "mkfsimage: write to %s failed\n", argv[1]);
+        fclose(out);
+        return 1;
+    }
+    fclose(out);
+
+    uint32_t total_files, total_size, free_size;
+    fs_get_stats(&total_files, &total_size, &free_size);
+    printf("Wrote %s: %u entries, %u bytes of data (%d imported, %d skipped)\n",
+           argv[1], total_files, total_size, files_added, files_skipped);
+
+    return 0;
+}
@@ -3,13 +3,14 @@
 #include "../include/kernel/keyboard.h"
 #include "../include/kernel/memory.h"
 #include "../include/kernel/shell.h"
+#include "../include/kernel/vfs.h"
 #include "../include/libc/stdio.h"
 
 #ifdef TEST_MODE
 extern void keyboard_cleanup(void);
 #endif
 
-int main(void) {
+int main(int argc, char* argv[]) {
     printf("MyOS Interactive Shell Test\n");
     printf("===========================\n\n");
     
@@ -17,12 +18,25 @@ int main(void) {
     memory_init();
     console_init();
     keyboard_init();
-    fs_init();
+    
+    // Optional host file keeps the file system across runs
+    if (argc > 1) {
+        int result = fs_open_backing_file(argv[1]);
+        if (result < 0) {
+            printf("Cannot use %s as file system backing store (error %d)\n", argv[1], result);
+            return 1;
+        }
+        printf("File system %s %s\n", result == 1 ? "created in" : "loaded from", argv[1]);
+    } else {
+        fs_init();
+    }
+    vfs_init();
     shell_init();
     
     printf("Interactive shell is now running!\n");
     printf("Try commands like: help, ls, cat welcome.txt, mkdir test, etc.\n");
-    printf("Type 'exit' to quit.\n\n");
+    printf("Type 'exit' to quit.\n");
+    printf("Run with a file argument to persist the file system ('sync' flushes it).\n\n");
     
     // Run the shell
     shell_run();
@@ -1,8 +1,184 @@
 #include "../include/kernel/console.h"
+#include "../include/kernel/ansi.h"
 #include "../include/kernel/memory.h"
+#include "../include/kernel/scrollback.h"
 #include "../include/libc/stdio.h"
+#include "../include/libc/string.h"
 
-int main(void) {
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+// Feed a whole string; returns the result for its last character
+static int feed(ansi_parser_t* parser, const char* text) {
+    int result = ANSI_TEXT;
+    while (*text) {
+        result = ansi_feed(parser, *text++);
+    }
+    return result;
+}
+
+static uint8_t attribute(enum vga_color fg, enum vga_color bg) {
+    return fg | bg << 4;
+}
+
+void test_ansi_parser(void) {
+    printf("=== ANSI Parser Test ===\n");
+    
+    ansi_parser_t parser;
+    ansi_init(&parser);
+    uint8_t grey = attribute(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    
+    check(ansi_feed(&parser, 'a') == ANSI_TEXT, "plain text is not consumed");
+    check(ansi_feed(&parser, '\033') == ANSI_PENDING && parser.state == ANSI_START, "ESC starts a sequence");
+    check(ansi_feed(&parser, 'X') == ANSI_PENDING && parser.state == ANSI_NONE, "ESC without '[' is dropped");
+    check(ansi_feed(&parser, 'b') == ANSI_TEXT, "text follows a dropped sequence");
+    
+    // SGR
+    check(feed(&parser, "\033[31m") == ANSI_COMMAND && parser.final == 'm', "SGR completes on 'm'");
+    check(ansi_apply_sgr(&parser, grey) == attribute(VGA_COLOR_RED, VGA_COLOR_BLACK), "30-37 set the foreground");
+    feed(&parser, "\033[1;34;42m");
+    check(ansi_apply_sgr(&parser, grey) == attribute(VGA_COLOR_LIGHT_BLUE, VGA_COLOR_GREEN), "bold brightens, 40-47 set the background");
+    feed(&parser, "\033[97;104m");
+    check(ansi_apply_sgr(&parser, grey) == attribute(VGA_COLOR_WHITE, VGA_COLOR_LIGHT_BLUE), "90-97 and 100-107 are bright");
+    feed(&parser, "\033[39;49m");
+    check(ansi_apply_sgr(&parser, attribute(VGA_COLOR_RED, VGA_COLOR_BLUE)) == grey, "39 and 49 restore the defaults");
+    feed(&parser, "\033[m");
+    check(parser.count == 0 && ansi_apply_sgr(&parser, attribute(VGA_COLOR_RED, VGA_COLOR_BLUE)) == grey, "ESC[m resets");
+    feed(&parser, "\033[0;33m");
+    check(ansi_apply_sgr(&parser, attribute(VGA_COLOR_RED, VGA_COLOR_BLUE)) == attribute(VGA_COLOR_BROWN, VGA_COLOR_BLACK),
+          "0 resets before the next parameter");
+    feed(&parser, "\033[5m");
+    check(ansi_apply_sgr(&parser, grey) == grey, "unknown SGR parameters are ignored");
+    feed(&parser, "\033[0;0;0;0;31m");
+    check(parser.count == ANSI_MAX_PARAMS && ansi_apply_sgr(&parser, grey) == grey, "parameters past the limit are dropped");
+    
+    // CUP
+    size_t row, col;
+    check(feed(&parser, "\033[5;10H") == ANSI_COMMAND && parser.final == 'H', "CUP completes on 'H'");
+    ansi_cursor_position(&parser, &row, &col);
+    check(row == 4 && col == 9, "CUP positions count from 1");
+    feed(&parser, "\033[H");
+    ansi_cursor_position(&parser, &row, &col);
+    check(row == 0 && col == 0, "CUP without parameters goes home");
+    feed(&parser, "\033[;7f");
+    ansi_cursor_position(&parser, &row, &col);
+    check(parser.final == 'f' && row == 0 && col == 6, "an empty row parameter means the first row");
+    feed(&parser, "\033[12H");
+    ansi_cursor_position(&parser, &row, &col);
+    check(row == 11 && col == 0, "a missing column means the first column");
+    
+    // ED
+    check(feed(&parser, "\033[2J") == ANSI_COMMAND && parser.final == 'J' &&
+          parser.count == 1 && parser.params[0] == 2, "ED 2 parses");
+    check(feed(&parser, "\033[2") == ANSI_PENDING && parser.state == ANSI_CSI, "an unfinished sequence stays pending");
+    check(ansi_feed(&parser, 'J') == ANSI_COMMAND && parser.params[0] == 2, "a sequence can span writes");
+    
+    printf("ANSI parser test completed!\n\n");
+}
+
+#define SCROLLBACK_TEST_LINES 600
+#define SCROLLBACK_TEST_WIDTH 80
+
+static uint16_t saved_rows[SCROLLBACK_TEST_LINES][SCROLLBACK_MAX_WIDTH];
+static scrollback_t scrollback;
+
+// Line n: text of varying length in a few colour runs, then blanks
+static void make_row(uint32_t n, uint16_t* row, size_t width) {
+    uint32_t seed = n * 2654435761u + 1;
+    size_t length = seed % (width + 1);
+    uint8_t attribute = 0x07;
+    for (size_t x = 0; x < width; x++) {
+        seed = seed * 1103515245 + 12345;
+        if ((seed >> 16) % 9 == 0) {
+            attribute = (seed >> 8) & 0x7F;
+        }
+        row[x] = x < length ? (uint16_t)(('!' + (seed >> 20) % 90) | attribute << 8) : SCROLLBACK_BLANK;
+    }
+}
+
+// Bytes the record for a row takes: sizes, length, runs and text
+static uint32_t record_size(const uint16_t* row, size_t width) {
+    size_t length = width;
+    while (length > 0 && row[length - 1] == SCROLLBACK_BLANK) {
+        length--;
+    }
+    uint32_t runs = 0;
+    for (size_t x = 0; x < length; x++) {
+        runs += x == 0 || (row[x] >> 8) != (row[x - 1] >> 8);
+    }
+    return 5 + 2 * runs + length;
+}
+
+// Every held line decodes to what was appended, newest first
+static bool scrollback_matches(uint32_t appended, size_t width) {
+    uint16_t row[SCROLLBACK_MAX_WIDTH];
+    for (uint32_t back = 0; back < scrollback.lines; back++) {
+        scrollback_decode(&scrollback, back, row, width);
+        if (memcmp(row, saved_rows[appended - 1 - back], width * sizeof(uint16_t)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void test_scrollback(void) {
+    printf("=== Scrollback Test ===\n");
+    
+    scrollback_init(&scrollback);
+    uint16_t row[SCROLLBACK_MAX_WIDTH];
+    
+    // A blank line keeps no text; decoding pads it back out
+    for (size_t x = 0; x < SCROLLBACK_TEST_WIDTH; x++) {
+        saved_rows[0][x] = SCROLLBACK_BLANK;
+    }
+    scrollback_append(&scrollback, saved_rows[0], SCROLLBACK_TEST_WIDTH);
+    check(scrollback.lines == 1 && scrollback.used == 5, "a blank line is a five-byte record");
+    check(scrollback_matches(1, SCROLLBACK_TEST_WIDTH), "a blank line decodes to blanks");
+    
+    // Enough lines to wrap the ring several times and evict the oldest
+    bool intact = true;
+    uint32_t written = scrollback.used;
+    for (uint32_t n = 1; n < SCROLLBACK_TEST_LINES; n++) {
+        make_row(n, saved_rows[n], SCROLLBACK_TEST_WIDTH);
+        scrollback_append(&scrollback, saved_rows[n], SCROLLBACK_TEST_WIDTH);
+        written += record_size(saved_rows[n], SCROLLBACK_TEST_WIDTH);
+        if (n % 37 == 0 || n == SCROLLBACK_TEST_LINES - 1) {
+            intact &= scrollback_matches(n + 1, SCROLLBACK_TEST_WIDTH);
+        }
+    }
+    check(written > 2 * CONSOLE_SCROLLBACK_SIZE, "the ring wraps more than once");
+    check(scrollback.lines < SCROLLBACK_TEST_LINES, "the oldest lines are evicted");
+    check(scrollback.used <= CONSOLE_SCROLLBACK_SIZE, "the ring never overfills");
+    check(intact, "lines round-trip across wraps and evictions");
+    
+    // Evicting walks the sizes at the front of the records
+    uint32_t held = 0;
+    for (uint32_t back = 0; back < scrollback.lines; back++) {
+        held += record_size(saved_rows[SCROLLBACK_TEST_LINES - 1 - back], SCROLLBACK_TEST_WIDTH);
+    }
+    check(held == scrollback.used, "held bytes match the records' sizes");
+    check(CONSOLE_SCROLLBACK_SIZE - held < record_size(saved_rows[SCROLLBACK_TEST_LINES - 1 - scrollback.lines],
+                                                       SCROLLBACK_TEST_WIDTH),
+          "only as many lines are evicted as needed");
+    
+    // The widest row, a colour change at every cell, is the largest record
+    for (size_t x = 0; x < SCROLLBACK_MAX_WIDTH; x++) {
+        saved_rows[0][x] = (uint16_t)(('A' + x % 26) | (x % 2 ? 0x1E00 : 0x4F00));
+    }
+    scrollback_append(&scrollback, saved_rows[0], SCROLLBACK_MAX_WIDTH);
+    scrollback_decode(&scrollback, 0, row, SCROLLBACK_MAX_WIDTH);
+    check(memcmp(row, saved_rows[0], sizeof(row)) == 0, "a full-width line round-trips");
+    
+    printf("Scrollback test completed!\n\n");
+}
+
+void test_console_output(void) {
     printf("=== Console Test ===\n");
     
     memory_init();
@@ -29,7 +205,18 @@ int main(void) {
     printf("Tab:\tTabbed text\n");
     printf("Newline:\nNew line\n");
     
-    printf("Console test completed!\n");
+    printf("Console test completed!\n\n");
+}
+
+int main(void) {
+    test_console_output();
+    test_ansi_parser();
+    test_scrollback();
     
+    if (failures > 0) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All console tests passed!\n");
     return 0;
 }
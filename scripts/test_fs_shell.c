@@ -1,10 +1,30 @@
+#include "../include/kernel/bcache.h"
+#include "../include/kernel/blockdev.h"
 #include "../include/kernel/fs.h"
+#include "../include/kernel/fs_disk.h"
+#include "../include/kernel/journal.h"
 #include "../include/kernel/shell.h"
 #include "../include/kernel/console.h"
 #include "../include/kernel/memory.h"
+#include "../include/kernel/vfs.h"
 #include "../include/libc/stdio.h"
 #include "../include/libc/string.h"
 
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+// Compare a file's contents with the expected bytes
+static bool file_equals(const char* path, const void* expected, int size) {
+    static char contents[FS_MAX_FILE_SIZE];
+    return fs_read_file(path, contents, sizeof(contents)) == size && memcmp(contents, expected, size) == 0;
+}
+
 void test_filesystem(void) {
     printf("=== File System Test ===\n");
     
@@ -57,6 +77,7 @@ void test_filesystem(void) {
 void test_shell_commands(void) {
     printf("=== Shell Commands Test ===\n");
     
+    vfs_init();
     shell_init();
     
     printf("Testing shell commands...\n");
@@ -82,25 +103,287 @@ void test_shell_commands(void) {
     printf("\n> ls /test\n");
     shell_process_command("ls /test");
     
+    printf("\n> touch /tmp/scratch.txt\n");
+    shell_process_command("touch /tmp/scratch.txt");
+    
+    printf("\n> ls -l /tmp\n");
+    shell_process_command("ls -l /tmp");
+    
+    printf("\n> ls /dev\n");
+    shell_process_command("ls /dev");
+    
+    printf("\n> cat /proc/mounts\n");
+    shell_process_command("cat /proc/mounts");
+    
+    char original[FS_MAX_FILE_SIZE];
+    int original_size = fs_read_file("/readme.txt", original, sizeof(original));
+    
+    printf("\n> chattr +c /readme.txt\n");
+    shell_process_command("chattr +c /readme.txt");
+    check((fs_lookup("/readme.txt")->flags & FS_FLAG_COMPRESSED) != 0, "chattr +c stores the file compressed");
+    check(file_equals("/readme.txt", original, original_size), "compressed file reads back unchanged");
+    
+    printf("\n> cat /readme.txt\n");
+    shell_process_command("cat /readme.txt");
+    
+    printf("\n> cat /proc/fsstats\n");
+    shell_process_command("cat /proc/fsstats");
+    
+    printf("\n> cat /proc/cmdstats\n");
+    shell_process_command("cat /proc/cmdstats");
+    
     printf("\n> pwd\n");
     shell_process_command("pwd");
-    
+
+    // An identical copy shares the original's blocks, which stat reports
+    char copy[1024];
+    uint32_t logical, physical, shared_logical, shared_physical;
+    fs_get_dedup_stats(&logical, &physical);
+    int copy_size = fs_read_file("/welcome.txt", copy, sizeof(copy));
+    fs_write_file("/home/user/welcome.txt", copy, copy_size);
+    fs_get_dedup_stats(&shared_logical, &shared_physical);
+    check(shared_logical > logical && shared_physical == physical, "an identical copy shares every block");
+
+    // The shell compacts while waiting for keys; finish it before stat
+    while (fs_compact_step(16) > 0) {
+    }
+
     printf("\n> stat\n");
     shell_process_command("stat");
-    
+
+    char motd[FS_MAX_FILE_SIZE];
+    int motd_size = fs_read_file("/etc/motd", motd, sizeof(motd));
+    fs_get_dedup_stats(&logical, &physical);
+
+    printf("\n> snapshot create\n");
+    shell_process_command("snapshot create");
+    fs_get_dedup_stats(&shared_logical, &shared_physical);
+    check(shared_logical == logical && shared_physical == physical, "a snapshot leaves the dedup statistics alone");
+
+    printf("\n> rm /etc/motd\n");
+    shell_process_command("rm /etc/motd");
+    check(!fs_file_exists("/etc/motd"), "rm removes the file");
+
+    printf("\n> snapshot restore 0\n");
+    shell_process_command("snapshot restore 0");
+    check(motd_size > 0 && file_equals("/etc/motd", motd, motd_size), "snapshot restore brings the file back");
+
+    printf("\n> cat /etc/motd\n");
+    shell_process_command("cat /etc/motd");
+
+    printf("\n> ls /etc\n");
+    shell_process_command("ls /etc");
+
+    printf("\n> echo /etc/*\n");
+    shell_process_command("echo /etc/*");
+
+    printf("\n> tree /home\n");
+    shell_process_command("tree /home");
+
+    printf("\n> du -s /etc\n");
+    shell_process_command("du -s /etc");
+
+    printf("\n> find / -name *.txt\n");
+    shell_process_command("find / -name *.txt");
+
+    printf("\n> grep -n Alpha /etc/motd /etc/version\n");
+    shell_process_command("grep -n Alpha /etc/motd /etc/version");
+
+    printf("\n> grep -r note /home\n");
+    shell_process_command("grep -r note /home");
+
     printf("\n> mem\n");
     shell_process_command("mem");
     
     printf("Shell commands test completed successfully!\n\n");
 }
 
+// A block device in memory; reads or writes can be made to fail
+typedef struct {
+    block_device_t dev;
+    uint8_t* data;
+    bool fail_reads;
+    bool fail_writes;
+} ram_disk_t;
+
+static int ram_read(block_device_t* dev, uint32_t lba, uint32_t count, void* buffer) {
+    ram_disk_t* ram = (ram_disk_t*)dev->driver_data;
+    if (ram->fail_reads) {
+        return -1;
+    }
+    memcpy(buffer, ram->data + lba * BLOCKDEV_SECTOR_SIZE, count * BLOCKDEV_SECTOR_SIZE);
+    return 0;
+}
+
+static int ram_write(block_device_t* dev, uint32_t lba, uint32_t count, const void* buffer) {
+    ram_disk_t* ram = (ram_disk_t*)dev->driver_data;
+    if (ram->fail_writes) {
+        return -1;
+    }
+    memcpy(ram->data + lba * BLOCKDEV_SECTOR_SIZE, buffer, count * BLOCKDEV_SECTOR_SIZE);
+    return 0;
+}
+
+static void ram_disk_init(ram_disk_t* ram, const char* name, uint8_t* data, uint32_t sectors) {
+    memset(ram, 0, sizeof(ram_disk_t));
+    strcpy(ram->dev.name, name);
+    ram->dev.driver = "ram";
+    ram->dev.sector_count = sectors;
+    ram->dev.read = ram_read;
+    ram->dev.write = ram_write;
+    ram->dev.driver_data = ram;
+    ram->data = data;
+}
+
+#define SMALL_DISK_SECTORS 1024  // Twice as many blocks as the cache holds
+#define FS_DISK_SECTORS (FS_DISK_DATA_SECTORS + 2048)  // Data area plus metadata
+
+static uint8_t small_disk_data[SMALL_DISK_SECTORS * BLOCKDEV_SECTOR_SIZE];
+static uint8_t fs_disk_data[FS_DISK_SECTORS * BLOCKDEV_SECTOR_SIZE];
+
+void test_buffer_cache(void) {
+    printf("=== Buffer Cache Test ===\n");
+    
+    static ram_disk_t ram;
+    ram_disk_init(&ram, "ram0", small_disk_data, SMALL_DISK_SECTORS);
+    for (uint32_t i = 0; i < sizeof(small_disk_data); i++) {
+        small_disk_data[i] = (uint8_t)(i * 7 + i / 4096);
+    }
+    bcache_init();
+    
+    // A failed read must not leave an empty buffer that later counts as a hit
+    ram.fail_reads = true;
+    check(bcache_get(&ram.dev, 3) == NULL, "a failed read returns no buffer");
+    ram.fail_reads = false;
+    
+    bcache_stats_t before, after;
+    bcache_get_stats(&before);
+    bcache_buffer_t* buf = bcache_get(&ram.dev, 3);
+    bcache_get_stats(&after);
+    check(buf && after.misses == before.misses + 1, "the block is read again after a failed read");
+    check(buf && memcmp(buf->data, small_disk_data + 3 * BCACHE_BLOCK_SIZE, BCACHE_BLOCK_SIZE) == 0,
+          "the reread block holds the device contents");
+    bcache_release(buf);
+    
+    // Cycle every buffer through other blocks, the failed one included
+    bool intact = true;
+    for (int pass = 0; pass < 2; pass++) {
+        for (uint32_t block = 0; block < SMALL_DISK_SECTORS / BCACHE_SECTORS_PER_BLOCK; block++) {
+            buf = bcache_get(&ram.dev, block);
+            intact &= buf && memcmp(buf->data, small_disk_data + block * BCACHE_BLOCK_SIZE, BCACHE_BLOCK_SIZE) == 0;
+            bcache_release(buf);
+        }
+    }
+    check(intact, "every block reads correctly once the buffers are reused");
+    
+    // Reads and writes at sector granularity
+    uint8_t bytes[3000];
+    check(bcache_read(&ram.dev, 9, 700, bytes, sizeof(bytes)) == 0 &&
+          memcmp(bytes, small_disk_data + 9 * BLOCKDEV_SECTOR_SIZE + 700, sizeof(bytes)) == 0,
+          "bcache_read returns the bytes at sector plus offset");
+    
+    // A failed write-back keeps the data dirty for the next flush
+    memset(bytes, 0x5A, sizeof(bytes));
+    bcache_write(&ram.dev, 1, 0, bytes, BLOCKDEV_SECTOR_SIZE);
+    ram.fail_writes = true;
+    check(bcache_flush(&ram.dev) != 0, "flush reports a failed write");
+    ram.fail_writes = false;
+    buf = bcache_get(&ram.dev, 0);
+    check(buf && (buf->flags & BCACHE_DIRTY), "a failed flush leaves the buffer dirty");
+    bcache_release(buf);
+    
+    // So does a device that refuses writes before the driver sees them
+    ram.dev.write = NULL;
+    check(bcache_flush(&ram.dev) != 0, "flush to a read-only device fails");
+    buf = bcache_get(&ram.dev, 0);
+    check(buf && (buf->flags & BCACHE_DIRTY), "a rejected flush leaves the buffer dirty");
+    bcache_release(buf);
+    ram.dev.write = ram_write;
+    
+    check(bcache_flush(&ram.dev) == 0 &&
+          memcmp(small_disk_data + BLOCKDEV_SECTOR_SIZE, bytes, BLOCKDEV_SECTOR_SIZE) == 0,
+          "a later flush writes the data");
+    
+    printf("Buffer cache test completed!\n\n");
+}
+
+void test_journal(void) {
+    printf("=== Journal Test ===\n");
+    
+    static ram_disk_t ram;  // Stays attached after the test returns
+    ram_disk_init(&ram, "ram1", fs_disk_data, FS_DISK_SECTORS);
+    check(fs_disk_format(&ram.dev) == 0, "format a RAM disk");
+    
+    // A committed change is replayed from the log after a crash
+    const char* note = "Logged but never checkpointed.\n";
+    fs_write_file("/journal.txt", note, strlen(note));
+    check(fs_commit() == 0, "commit a transaction");
+    
+    memset(fs_get_instance()->entries, 0, sizeof(fs_get_instance()->entries));
+    int replayed = fs_disk_mount(&ram.dev);
+    printf("Remounted, %d transaction(s) replayed\n", replayed);
+    check(replayed >= 1, "mount replays the committed transaction");
+    check(file_equals("/journal.txt", note, strlen(note)), "replayed file has its contents");
+    
+    // One operation too large for a transaction is checkpointed instead
+    static char big[3][FS_MAX_FILE_SIZE];
+    for (int f = 0; f < 3; f++) {
+        for (int i = 0; i < FS_MAX_FILE_SIZE; i++) {
+            big[f][i] = (char)(i * (f + 3) + i / 251);
+        }
+    }
+    journal_stats_t before, after;
+    journal_get_stats(&before);
+    fs_write_file("/big0.bin", big[0], FS_MAX_FILE_SIZE);
+    fs_write_file("/big1.bin", big[1], FS_MAX_FILE_SIZE);
+    fs_write_file("/big2.bin", big[2], FS_MAX_FILE_SIZE);
+    check(fs_commit() == 0, "commit an oversized transaction");
+    journal_get_stats(&after);
+    check(after.transactions == before.transactions && after.checkpoints == before.checkpoints + 1,
+          "an oversized transaction is checkpointed, not split");
+    
+    printf("Journal test completed!\n\n");
+}
+
+void test_disk_format(void) {
+    printf("=== On-Disk Format Test ===\n");
+    
+    // A device without the superblock magic is not mounted
+    static ram_disk_t blank;
+    memset(small_disk_data, 0, sizeof(small_disk_data));
+    ram_disk_init(&blank, "ram2", small_disk_data, SMALL_DISK_SECTORS);
+    check(fs_disk_mount(&blank.dev) == -2, "a blank device holds no file system");
+    
+    // Checkpointed state comes back from the home locations alone
+    block_device_t* dev = fs_disk_get_device();
+    check(dev != NULL && fs_disk_sync() == 0, "checkpoint the attached disk");
+    
+    char expected[FS_MAX_FILE_SIZE];
+    int expected_size = fs_read_file("/big1.bin", expected, sizeof(expected));
+    memset(fs_get_instance()->entries, 0, sizeof(fs_get_instance()->entries));
+    check(dev != NULL && fs_disk_mount(dev) == 0, "mount after a checkpoint replays nothing");
+    check(fs_disk_resident_sectors() == 0, "mount leaves file data on disk");
+    check(expected_size == FS_MAX_FILE_SIZE && file_equals("/big1.bin", expected, expected_size),
+          "file data is faulted in from the data region");
+    check(fs_file_exists("/journal.txt"), "every entry survives a remount");
+    
+    printf("On-disk format test completed!\n\n");
+}
+
 int main(void) {
     printf("MyOS Test Suite\n");
     printf("===============\n\n");
     
     test_filesystem();
     test_shell_commands();
+    test_buffer_cache();
+    test_journal();
+    test_disk_format();
     
+    if (failures > 0) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
     printf("All tests completed successfully!\n");
     printf("You can now build the full OS with 'make iso' and run it with 'make run'\n");
     